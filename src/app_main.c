@@ -32,6 +32,13 @@
 
 #define CONDITIONAL_REDISPLAY  { if (UX_ALLOWED) UX_REDISPLAY() };
 
+// N_DATA.key entries of the selected key and of the successor key
+#define KEY_BUFFER      (N_appdata.key_buffer ^ N_appdata.slot)
+#define SPARE_BUFFER    (N_appdata.spare_buffer ^ XMSS_KEY_SLOTS)
+
+// Key currently used for signing
+#define N_KEY (N_DATA.key[KEY_BUFFER])
+
 unsigned char G_io_seproxyhal_spi_buffer[IO_SEPROXYHAL_BUFFER_SIZE_B];
 app_ctx_t ctx;
 
@@ -39,6 +46,51 @@ bool parse_unsigned_message(volatile uint32_t *tx, uint32_t rx);
 
 void hash_tx(uint8_t msg[32]);
 
+void app_successor_step();
+
+// Keygen state in ctx.keygen belongs to N_DATA.key entry keygen_buffer - 1, 0 if none
+uint8_t keygen_buffer = 0;
+
+// Set from LEASE_ISSUE until the user answers, ctx.lease is on screen until then
+bool lease_pending = false;
+
+// Idle-time work, one bounded slice per ticker event: a keygen slice, a chain of the
+// signature under review, seed and R of the current index, then the successor key
+void app_idle_step() {
+    if (N_appdata.mode == APPMODE_KEYGEN_RUNNING) {
+        const uint16_t checkpoint = N_appdata.xmss_index;
+        app_initialize_xmss_step();
+        if (N_appdata.xmss_index != checkpoint && view_uiState == UI_IDLE) {
+            view_update_state(50);
+            view_main_menu();
+        }
+        return;
+    }
+    if (ctx.sig_state != SIGSTATE_IDLE) {
+        xmss_sign_nv_step(&ctx.xmss_sig_ctx, &N_DATA.signature);
+        return;
+    }
+    if (N_appdata.mode != APPMODE_READY) {
+        return;
+    }
+    if (N_appdata.xmss_index < APP_INDEX_LIMIT) {
+        xmss_precomp_fill(&ctx.precomp, &N_KEY.sk, N_appdata.xmss_index);
+    }
+    // as many indices left as past the threshold of an unleased key
+    if (N_appdata.xmss_index + (XMSS_NUM_NODES - KEY_SUCCESSOR_THRESHOLD) < APP_INDEX_LIMIT) {
+        return;
+    }
+    // the last generation has no successor, its path element would wrap
+    if (N_appdata.key_generation >= KEY_GENERATION_MAX) {
+        return;
+    }
+    // the spare entry serves one slot at a time
+    if (N_appdata.next_mode == APPMODE_NOT_INITIALIZED ||
+        (N_appdata.next_slot == N_appdata.slot && N_appdata.next_mode != APPMODE_READY)) {
+        app_successor_step();
+    }
+}
+
 unsigned char io_event(unsigned char channel) {
     switch (G_io_seproxyhal_spi_buffer[0]) {
         case SEPROXYHAL_TAG_FINGER_EVENT: //
@@ -56,6 +108,7 @@ unsigned char io_event(unsigned char channel) {
 
         case SEPROXYHAL_TAG_TICKER_EVENT: {
             UX_TICKER_EVENT(G_io_seproxyhal_spi_buffer, CONDITIONAL_REDISPLAY);
+            app_idle_step();
         }
             break;
 
@@ -112,7 +165,8 @@ const uint32_t bip32_path[5] = {
         0x80000000 | 0
 };
 
-void get_seed(uint8_t *seed) {
+// 48 bytes of key material from the BIP32 node at `path`
+void get_path_seed(uint8_t *seed, const uint32_t path[5]) {
     union {
         unsigned char all[64];
         struct {
@@ -125,11 +179,12 @@ void get_seed(uint8_t *seed) {
 
 #ifdef TESTING_MOCKSEED
     // Keep as all zeros for reproducible tests
+    UNUSED(path);
 #else
     unsigned char tmp_out[64];
 
     os_memset(u.all, 0, 64);
-    os_perso_derive_node_bip32(CX_CURVE_SECP256K1, bip32_path, 5, u.seed, u.chain);
+    os_perso_derive_node_bip32(CX_CURVE_SECP256K1, (uint32_t *) path, 5, u.seed, u.chain);
 
     cx_sha3_t hash_sha3;
     cx_sha3_init(&hash_sha3, 512);
@@ -138,6 +193,28 @@ void get_seed(uint8_t *seed) {
 #endif
 }
 
+// Each slot uses its own account, successor keys the same path with the last element
+// set to their generation
+void get_seed(uint8_t *seed, uint8_t slot, uint32_t generation) {
+    uint32_t path[5];
+    memcpy(path, bip32_path, sizeof(path));
+    path[2] |= slot;
+    path[4] |= generation;
+    get_path_seed(seed, path);
+}
+
+// Range lease tags are keyed from the change branch (1') of the slot's account, so every
+// device holding the seed can check them
+void get_lease_key(uint8_t *key, uint8_t slot) {
+    uint8_t seed[48];
+    uint32_t path[5];
+    memcpy(path, bip32_path, sizeof(path));
+    path[2] |= slot;
+    path[3] |= 1;
+    get_path_seed(seed, path);
+    memcpy(key, seed, 32);
+}
+
 /// Get the message to sign from the buffer
 bool parse_unsigned_message(volatile uint32_t *tx, uint32_t rx) {
     if (N_appdata.mode != APPMODE_READY) {
@@ -165,8 +242,10 @@ bool parse_unsigned_message(volatile uint32_t *tx, uint32_t rx) {
         THROW(APDU_CODE_DATA_INVALID);
     }
 
-    // move the buffer to the tx ctx
-    memcpy((uint8_t * ) & ctx.qrltx, msg, rx);
+    // move the buffer to the tx ctx, the signing state after it is kept for a replay
+    // qrltx is followed by the signing and keygen state, only the tx itself is copied
+    keygen_buffer = 0;
+    memcpy((uint8_t * ) & ctx.qrltx, msg, rx - 5);
 
     return true;
 }
@@ -227,13 +306,14 @@ void test_pk_gen2(volatile uint32_t *tx, uint32_t rx)
     UNUSED(data);
 
     const uint16_t idx = (p1<<8u)+p2;
-    const uint8_t *p=N_DATA.xmss_nodes + 32 * idx;
+    const uint8_t *p=N_KEY.xmss_nodes + 32 * idx;
 
     uint8_t seed[48];
-    get_seed(seed);
+    get_seed(seed, N_appdata.slot, N_appdata.key_generation);
 
-    xmss_gen_keys_1_get_seeds(&N_DATA.sk, seed);
-    xmss_gen_keys_2_get_nodes((uint8_t*) &N_DATA.wots_buffer, (void*)p, &N_DATA.sk, idx);
+    uint8_t wots_buffer[WOTS_LEN * WOTS_N];
+    xmss_gen_keys_1_get_seeds(&N_KEY.sk, seed);
+    xmss_gen_keys_2_get_nodes(wots_buffer, (void*)p, &N_KEY.sk, idx);
 
     os_memmove(G_io_apdu_buffer, p, 32);
     *tx+=32;
@@ -281,7 +361,7 @@ void test_write_leaf(volatile uint32_t *tx, uint32_t rx)
 
     const uint8_t size = rx-4;
     const uint8_t index = p1;
-    const uint8_t *p=N_DATA.xmss_nodes + 32 * index;
+    const uint8_t *p=N_KEY.xmss_nodes + 32 * index;
 
     snprintf(view_buffer_value, sizeof(view_buffer_value), "W[%03d]: %03d", size, index);
     debug_printf(view_buffer_value);
@@ -300,13 +380,8 @@ void test_calc_pk(volatile uint32_t *tx, uint32_t rx)
     snprintf(view_buffer_value, sizeof(view_buffer_value), "keygen: root");
     debug_printf(view_buffer_value);
 
-    xmss_pk_t pk;
-    memset(pk.raw, 0, 64);
-
-    xmss_gen_keys_3_get_root(N_DATA.xmss_nodes, &N_DATA.sk);
-    xmss_pk(&pk, &N_DATA.sk);
-
-    nvm_write(N_appdata.pk.raw, pk.raw, 64);
+    xmss_gen_keys_3_build_tree(N_KEY.xmss_nodes, &N_KEY.xmss_tree, &N_KEY.sk);
+    xmss_precomp_invalidate(&ctx.precomp);
 
     appstorage_t tmp;
     tmp.mode = APPMODE_READY;
@@ -331,7 +406,7 @@ void test_read_leaf(volatile uint32_t *tx, uint32_t rx)
     UNUSED(data);
 
     const uint8_t index = p1;
-    const uint8_t *p=N_DATA.xmss_nodes + 32 * index;
+    const uint8_t *p=N_KEY.xmss_nodes + 32 * index;
 
     os_memmove(G_io_apdu_buffer, p, 32);
 
@@ -357,7 +432,7 @@ void test_get_seed(volatile uint32_t *tx, uint32_t rx)
     UNUSED(data);
 
     uint8_t seed[48];
-    get_seed(seed);
+    get_seed(seed, N_appdata.slot, N_appdata.key_generation);
 
     os_memmove(G_io_apdu_buffer, seed, 48);
     *tx+=48;
@@ -387,15 +462,15 @@ void test_digest(volatile uint32_t *tx, uint32_t rx)
     hash_tx(msg);
 
     uint8_t seed[48];
-    get_seed(seed);
+    get_seed(seed, N_appdata.slot, N_appdata.key_generation);
 
-    xmss_gen_keys_1_get_seeds(&N_DATA.sk, seed);
+    xmss_gen_keys_1_get_seeds(&N_KEY.sk, seed);
 
     xmss_digest_t digest;
     memset(digest.raw, 0, XMSS_DIGESTSIZE);
 
     const uint8_t index = p1;
-    xmss_digest(&digest, msg, &N_DATA.sk, index);
+    xmss_digest(&digest, msg, &N_KEY.sk, index);
 
     snprintf(view_buffer_value, sizeof(view_buffer_value), "Digest idx %d", index+1);
     debug_printf(view_buffer_value);
@@ -405,6 +480,17 @@ void test_digest(volatile uint32_t *tx, uint32_t rx)
     *tx+=64;
     view_update_state(2000);
 }
+
+// Hash cost of each chunk of the last signature, as counted by the chunk scheduler
+uint16_t test_chunk_cost[11];
+
+void test_chunk_costs(volatile uint32_t *tx, uint32_t rx)
+{
+    UNUSED(rx);
+
+    os_memmove(G_io_apdu_buffer, test_chunk_cost, sizeof(test_chunk_cost));
+    *tx += sizeof(test_chunk_cost);
+}
 #endif
 
 ///////////////////////////////////////////////////////////
@@ -467,6 +553,52 @@ void app_get_state(volatile uint32_t *tx, uint32_t rx) {
     view_update_state(500);
 }
 
+// New seeds in N_DATA.key entry `buffer`, everything built from the old ones is dropped
+void app_keygen_begin(uint8_t buffer, uint8_t slot, uint32_t generation) {
+    NVCONST N_KEY_t *key = &N_DATA.key[buffer];
+    uint8_t
+    seed[48];
+
+    get_seed(seed, slot, generation);
+
+    xmss_gen_keys_1_get_seeds(&key->sk, seed);
+
+    const uint8_t not_ready = 0;
+    nvm_write((void *) &key->xmss_tree.ready, (void *) &not_ready, 1);
+    keygen_buffer = 0;
+}
+
+// One keygen slice of N_DATA.key entry `buffer`, resumed from leaf `checkpoint` if the RAM
+// state was lost. Returns the new checkpoint, 256 once the root is in the entry's sk
+uint16_t app_keygen_slice(uint8_t buffer, uint16_t checkpoint) {
+    NVCONST N_KEY_t *key = &N_DATA.key[buffer];
+
+    if (keygen_buffer != buffer + 1) {
+        xmss_keygen_init(&ctx.keygen, key->xmss_nodes, &key->xmss_tree, &key->stack, checkpoint);
+        keygen_buffer = buffer + 1;
+    }
+
+#ifdef TESTING_ENABLED
+    for (int idx  = 0; idx < 256; idx +=4){
+        nvm_write( (void *) (key->xmss_nodes + 32 * idx),
+                   (void *) test_xmss_leaves[idx],
+                   128);
+    }
+    xmss_gen_keys_3_build_tree(key->xmss_nodes, &key->xmss_tree, &key->sk);
+    ctx.keygen.leaf = 256;
+#else
+    // the root is written by the slice that finishes the last leaf
+    xmss_keygen_step(&ctx.keygen, &key->sk, KEYGEN_SLICE_COST);
+#endif
+
+    if (ctx.keygen.leaf < 256) {
+        // N_appdata only moves at checkpoints
+        return ctx.keygen.leaf & ~(KEYGEN_CHECKPOINT_LEAVES - 1);
+    }
+    keygen_buffer = 0;
+    return 256;
+}
+
 char app_initialize_xmss_step() {
     if (N_appdata.mode != APPMODE_NOT_INITIALIZED && N_appdata.mode != APPMODE_KEYGEN_RUNNING) {
         return false;
@@ -475,56 +607,147 @@ char app_initialize_xmss_step() {
 
     // Generate all leaves
     if (N_appdata.mode == APPMODE_NOT_INITIALIZED) {
-        uint8_t
-        seed[48];
-
-        get_seed(seed);
-
-        xmss_gen_keys_1_get_seeds(&N_DATA.sk, seed);
-
+        // cached data belongs to the previous key
+        app_keygen_begin(KEY_BUFFER, N_appdata.slot, N_appdata.key_generation);
+        const uint8_t not_ready = 0;
+        xmss_precomp_invalidate(&ctx.precomp);
+        nvm_write((void *) &N_DATA.signature_ready, (void *) &not_ready, 1);
+        if (N_appdata.next_slot == N_appdata.slot) {
+            nvm_write((void *) &N_appdata.next_mode, (void *) &not_ready, 1);
+        }
         tmp.mode = APPMODE_KEYGEN_RUNNING;
         tmp.xmss_index = 0;
 
         nvm_write((void *) &N_appdata.raw, &tmp.raw, sizeof(tmp.raw));
     }
 
-    if (N_appdata.xmss_index < 256) {
-        snprintf(view_buffer_value, sizeof(view_buffer_value), "keygen: %03d/256", N_appdata.xmss_index + 1);
-        debug_printf(view_buffer_value);
+    const uint16_t checkpoint = app_keygen_slice(KEY_BUFFER, N_appdata.xmss_index);
+    if (checkpoint == N_appdata.xmss_index) {
+        return true;
+    }
 
-#ifdef TESTING_ENABLED
-        for (int idx  = 0; idx < 256; idx +=4){
-            nvm_write( (void *) (N_DATA.xmss_nodes + 32 * idx),
-                       (void *) test_xmss_leaves[idx],
-                       128);
-        }
-        tmp.mode = APPMODE_KEYGEN_RUNNING;
-        tmp.xmss_index = 256;
-#else
-        const uint8_t *p = N_DATA.xmss_nodes + 32 * N_appdata.xmss_index;
-        xmss_gen_keys_2_get_nodes((uint8_t * ) & N_DATA.wots_buffer, (void *) p, &N_DATA.sk, N_appdata.xmss_index);
+    if (checkpoint < 256) {
         tmp.mode = APPMODE_KEYGEN_RUNNING;
-        tmp.xmss_index = N_appdata.xmss_index + 1;
-#endif
-
+        tmp.xmss_index = checkpoint;
     } else {
-        snprintf(view_buffer_value, sizeof(view_buffer_value), "keygen: root");
-        debug_printf(view_buffer_value);
+        // the lease range holds for every key of the slot
+        tmp.mode = APPMODE_READY;
+        tmp.xmss_index = N_appdata.lease_start;
+    }
 
-        xmss_pk_t pk;
-        memset(pk.raw, 0, 64);
+    nvm_write((void *) &N_appdata.raw, &tmp.raw, sizeof(tmp.raw));
+    return N_appdata.mode != APPMODE_READY;
+}
 
-        xmss_gen_keys_3_get_root(N_DATA.xmss_nodes, &N_DATA.sk);
-        xmss_pk(&pk, &N_DATA.sk);
+// Successor key of the selected slot in the spare entry, generated in idle time once the
+// index passes KEY_SUCCESSOR_THRESHOLD. Its progress is kept next to it in N_appdata
+void app_successor_step() {
+    if (N_appdata.next_mode == APPMODE_NOT_INITIALIZED) {
+        app_keygen_begin(SPARE_BUFFER, N_appdata.slot, N_appdata.key_generation + 1);
+
+        const uint8_t mode = APPMODE_KEYGEN_RUNNING;
+        const uint16_t index = 0;
+        nvm_write((void *) &N_appdata.next_slot, (void *) &N_appdata.slot, 1);
+        nvm_write((void *) &N_appdata.next_index, (void *) &index, 2);
+        nvm_write((void *) &N_appdata.next_mode, (void *) &mode, 1);
+        return;
+    }
 
-        nvm_write(N_appdata.pk.raw, pk.raw, 64);
+    const uint16_t checkpoint = app_keygen_slice(SPARE_BUFFER, N_appdata.next_index);
+    if (checkpoint == N_appdata.next_index) {
+        return;
+    }
+    nvm_write((void *) &N_appdata.next_index, (void *) &checkpoint, 2);
 
-        tmp.mode = APPMODE_READY;
-        tmp.xmss_index = 0;
+    if (checkpoint == 256) {
+        const uint8_t mode = APPMODE_READY;
+        nvm_write((void *) &N_appdata.next_mode, (void *) &mode, 1);
     }
+}
 
-    nvm_write((void *) &N_appdata.raw, &tmp.raw, sizeof(tmp.raw));
-    return N_appdata.mode != APPMODE_READY;
+/// Switches to the successor key and returns its pk (same layout as INS_PUBLIC_KEY)
+void app_rotate_key(volatile uint32_t *tx, uint32_t rx) {
+    if (N_appdata.mode != APPMODE_READY || N_appdata.next_mode != APPMODE_READY ||
+        N_appdata.next_slot != N_appdata.slot || N_appdata.key_generation >= KEY_GENERATION_MAX) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+    if (ctx.sig_state != SIGSTATE_IDLE || lease_pending) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+    if (rx < 5) {
+        THROW(APDU_CODE_WRONG_LENGTH);
+    }
+
+    // the precomputed slot and the stored signature belong to the old key
+    const uint8_t not_ready = 0;
+    xmss_precomp_invalidate(&ctx.precomp);
+    nvm_write((void *) &N_DATA.signature_ready, (void *) &not_ready, 1);
+
+    // entries, generation, index and successor state change in the one key commit
+    appstorage_t tmp;
+    memcpy(tmp.raw_key, N_appdata.raw_key, sizeof(tmp.raw_key));
+    tmp.mode = APPMODE_READY;
+    tmp.xmss_index = N_appdata.lease_start;       // the lease range holds for the next key too
+    tmp.key_buffer = SPARE_BUFFER ^ N_appdata.slot;
+    tmp.spare_buffer = KEY_BUFFER ^ XMSS_KEY_SLOTS;
+    tmp.key_generation = N_appdata.key_generation + 1;
+    tmp.next_mode = APPMODE_NOT_INITIALIZED;
+    nvm_write((void *) &N_appdata.raw_key, &tmp.raw_key, sizeof(tmp.raw_key));
+
+    xmss_pk_t pk;
+    xmss_pk(&pk, &N_KEY.sk);
+
+    G_io_apdu_buffer[0] = 0;        // XMSS, SHA2-256
+    G_io_apdu_buffer[1] = 4;        // Height 8
+    G_io_apdu_buffer[2] = 0;        // SHA256_X
+
+    os_memmove(G_io_apdu_buffer + 3, pk.raw, 64);
+    *tx += 67;
+
+    view_update_state(500);
+}
+
+/// Selects key slot P1 and returns its state (same layout as INS_GETSTATE). A slot used for
+/// the first time starts its keygen here, idle time does the rest
+void app_select_slot(volatile uint32_t *tx, uint32_t rx) {
+    if (rx < 5) {
+        THROW(APDU_CODE_WRONG_LENGTH);
+    }
+    const uint8_t p1 = G_io_apdu_buffer[2];
+    if (p1 >= XMSS_KEY_SLOTS) {
+        THROW(APDU_CODE_DATA_INVALID);
+    }
+    if (ctx.sig_state != SIGSTATE_IDLE || lease_pending) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+
+    if (p1 != N_appdata.slot) {
+        // the precomputed slot and the stored signature belong to the old key
+        const uint8_t not_ready = 0;
+        xmss_precomp_invalidate(&ctx.precomp);
+        nvm_write((void *) &N_DATA.signature_ready, (void *) &not_ready, 1);
+
+        // the record of the slot in use is not read while it is selected
+        nvm_write((void *) &N_appdata.slots[N_appdata.slot], (void *) &N_appdata.raw_key, sizeof(appslot_t));
+
+        // the selected slot's state and the slot number change in the one key commit
+        appstorage_t tmp;
+        memcpy(tmp.raw_key, N_appdata.raw_key, sizeof(tmp.raw_key));
+        memcpy(tmp.raw_key, &N_appdata.slots[p1], sizeof(appslot_t));
+        tmp.slot = p1;
+        nvm_write((void *) &N_appdata.raw_key, &tmp.raw_key, sizeof(tmp.raw_key));
+    }
+
+    if (N_appdata.mode == APPMODE_NOT_INITIALIZED) {
+        app_initialize_xmss_step();
+    }
+
+    G_io_apdu_buffer[0] = N_appdata.mode;
+    G_io_apdu_buffer[1] = N_appdata.xmss_index >> 8;
+    G_io_apdu_buffer[2] = N_appdata.xmss_index & 0xFF;
+    *tx += 3;
+
+    view_update_state(500);
 }
 
 void app_get_pk(volatile uint32_t *tx, uint32_t rx) {
@@ -547,41 +770,88 @@ void app_get_pk(volatile uint32_t *tx, uint32_t rx) {
     G_io_apdu_buffer[1] = 4;        // Height 8
     G_io_apdu_buffer[2] = 0;        // SHA256_X
 
-    os_memmove(G_io_apdu_buffer + 3, N_appdata.pk.raw, 64);
+    xmss_pk_t pk;
+    xmss_pk(&pk, &N_KEY.sk);
+    os_memmove(G_io_apdu_buffer + 3, pk.raw, 64);
     *tx += 67;
 
     THROW(APDU_CODE_OK);
     view_update_state(500);
 }
 
-/// This allows extracting the signature by chunks
-void app_sign(volatile uint32_t *tx, uint32_t rx) {
+/// Starts the signature while the user reviews the transaction
+/// Chains are computed on ticker events into N_DATA.signature, nothing is released
+/// and the index is not moved until the user approves
+void app_sign_speculate(const uint8_t msg[32]) {
+    // the buffer is about to be overwritten
+    const uint8_t not_ready = 0;
+    nvm_write((void *) &N_DATA.signature_ready, (void *) &not_ready, 1);
+    nvm_write((void *) N_DATA.signature_msg, (void *) msg, 32);
+
+    // the signing state overlays a paused successor keygen
+    keygen_buffer = 0;
+    xmss_sign_nv_init(
+            &ctx.xmss_sig_ctx,
+            &N_DATA.signature,
+            msg,
+            &N_KEY.sk,
+            (uint8_t * )
+    N_KEY.xmss_nodes,
+            &N_KEY.xmss_tree,
+            &ctx.precomp,
+            N_appdata.xmss_index);
+
+    ctx.sig_state = SIGSTATE_REVIEW;
+}
+
+/// A retried transaction gets the stored signature again, without approval or a new index
+/// Releasing it twice reveals nothing, it was approved for this tx hash
+bool app_sign_replay(const uint8_t msg[32]) {
+    if (memcmp(N_DATA.signature_msg, msg, 32) != 0) {
+        return false;
+    }
+
+    // approved but not read out yet: its index is committed, so it is finished, not redone
+    if (ctx.sig_state == SIGSTATE_APPROVED && N_DATA.signature_ready != 1) {
+        const uint16_t index = N_appdata.xmss_index - 1;      // It has already been updated
+        xmss_sign_nv_prepare(&ctx.xmss_sig_ctx, &N_DATA.signature, index, XMSS_SIGSIZE);
+        const uint8_t ready = 1;
+        nvm_write((void *) &N_DATA.signature_ready, (void *) &ready, 1);
+    }
+    if (N_DATA.signature_ready != 1) {
+        return false;
+    }
+
+    keygen_buffer = 0;
+    xmss_sign_nv_replay(&ctx.xmss_sig_ctx, &N_DATA.signature);
+    ctx.sig_state = SIGSTATE_REPLAY;
+    return true;
+}
+
+/// The user approved: commit the index, chunks can now be read
+void app_sign() {
     if (N_appdata.mode != APPMODE_READY) {
         THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
     }
 
-    if (N_appdata.xmss_index >= 256) {
+    if (N_appdata.xmss_index >= APP_INDEX_LIMIT || ctx.sig_state != SIGSTATE_REVIEW) {
         THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
     }
 
-    uint8_t msg[32];        // Used to store the tx hash
-    hash_tx(msg);
-
-    // buffer[2..3] are ignored (p1, p2)
-    xmss_sign_incremental_init(
-            &ctx.xmss_sig_ctx,
-            msg,
-            &N_DATA.sk,
-            (uint8_t * )
-    N_DATA.xmss_nodes,
-            N_appdata.xmss_index);
-
     // Move index forward
     appstorage_t tmp;
     tmp.mode = APPMODE_READY;
     tmp.xmss_index = N_appdata.xmss_index + 1;
     nvm_write((void *) &N_appdata.raw, &tmp.raw, sizeof(tmp.raw));
 
+    // The slot holds the index just used, it is refilled once the signature is read out
+    xmss_precomp_invalidate(&ctx.precomp);
+    ctx.sig_state = SIGSTATE_APPROVED;
+}
+
+/// Drops the signature in progress (rejected, replaced or fully read), the index stays
+void app_sign_clear() {
+    ctx.sig_state = SIGSTATE_IDLE;
 }
 
 /// This allows extracting the signature by chunks
@@ -589,7 +859,7 @@ void app_sign_next(volatile uint32_t *tx, uint32_t rx) {
     if (N_appdata.mode != APPMODE_READY) {
         THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
     }
-    if (ctx.xmss_sig_ctx.sig_chunk_idx > 10) {
+    if (ctx.sig_state != SIGSTATE_APPROVED && ctx.sig_state != SIGSTATE_REPLAY) {
         THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
     }
 
@@ -597,16 +867,36 @@ void app_sign_next(volatile uint32_t *tx, uint32_t rx) {
     const uint8_t p2 = G_io_apdu_buffer[3];
     const uint8_t *data = G_io_apdu_buffer + 5;
 
-    UNUSED(p1);
     UNUSED(p2);
-    UNUSED(data);
 
-    const uint16_t index = N_appdata.xmss_index - 1;      // It has already been updated
+    // The host holds the auth path of the index in data (big endian) and only needs
+    // the levels that changed in the last chunk
+    const bool delta = p1 == SIGN_NEXT_AUTHPATH_DELTA;
+    if (delta && rx != 7) {
+        THROW(APDU_CODE_WRONG_LENGTH);
+    }
+    const uint16_t cached_index = delta ? (uint16_t) ((data[0] << 8u) | data[1]) : 0;
+
+    const uint16_t index = N_appdata.xmss_index - 1;      // It has already been updated (unused on replay)
 
-    if (ctx.xmss_sig_ctx.sig_chunk_idx == 10) {
-        xmss_sign_incremental_last(&ctx.xmss_sig_ctx, G_io_apdu_buffer, &N_DATA.sk, index);
-    } else {
-        xmss_sign_incremental(&ctx.xmss_sig_ctx, G_io_apdu_buffer, &N_DATA.sk, index);
+    const uint8_t chunk = ctx.xmss_sig_ctx.sig_chunk_idx;
+    const bool last = xmss_sign_nv_chunk(&ctx.xmss_sig_ctx, G_io_apdu_buffer, &N_DATA.signature, &N_KEY.sk, index);
+#ifdef TESTING_ENABLED
+    test_chunk_cost[chunk] = ctx.xmss_sig_ctx.cost;
+#else
+    UNUSED(chunk);
+#endif
+    if (last && delta) {
+        const uint16_t sig_index = (uint16_t) NtoHL(N_DATA.signature.index);
+        ctx.xmss_sig_ctx.written = xmss_authpath_delta(G_io_apdu_buffer,
+                                                       N_DATA.signature.auth_path,
+                                                       sig_index,
+                                                       cached_index);
+    }
+    if (last) {
+        const uint8_t ready = 1;
+        nvm_write((void *) &N_DATA.signature_ready, (void *) &ready, 1);
+        app_sign_clear();
     }
 
     if (ctx.xmss_sig_ctx.written > 0) {
@@ -616,6 +906,192 @@ void app_sign_next(volatile uint32_t *tx, uint32_t rx) {
     view_update_state(1000);
 }
 
+/// Reads the signature by offset: P1-P2 = offset (big endian), data[0] = length
+/// Readable from approval on, so a lost INS_SIGN_NEXT reply is recovered from NV without
+/// a new index, also before the later chunks were read
+void app_sign_read(volatile uint32_t *tx, uint32_t rx) {
+    if (N_appdata.mode != APPMODE_READY) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+    if (rx != 6) {
+        THROW(APDU_CODE_WRONG_LENGTH);
+    }
+    const bool approved = ctx.sig_state == SIGSTATE_APPROVED;
+    if (N_DATA.signature_ready != 1 && !approved) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+
+    const uint8_t p1 = G_io_apdu_buffer[2];
+    const uint8_t p2 = G_io_apdu_buffer[3];
+    const uint8_t *data = G_io_apdu_buffer + 5;
+
+    const uint16_t offset = (uint16_t) ((p1 << 8u) | p2);
+    const uint16_t len = data[0];
+    if (len == 0 || offset + len > XMSS_SIGSIZE) {
+        THROW(APDU_CODE_DATA_INVALID);
+    }
+
+    // bytes the signature in progress has not reached yet are completed first
+    // INS_SIGN_NEXT carries on from there
+    if (approved && N_DATA.signature_ready != 1) {
+        const uint16_t index = N_appdata.xmss_index - 1;      // It has already been updated
+        if (xmss_sign_nv_prepare(&ctx.xmss_sig_ctx, &N_DATA.signature, index, offset + len)) {
+            const uint8_t ready = 1;
+            nvm_write((void *) &N_DATA.signature_ready, (void *) &ready, 1);
+        }
+    }
+
+    os_memmove(G_io_apdu_buffer, N_DATA.signature.raw + offset, len);
+    *tx += len;
+}
+
+// Tag of the lease [start, end) of the selected key for the device that sent `nonce`:
+// HMAC-SHA256 over root, start, end and nonce
+void lease_tag(uint8_t tag[32], uint16_t start, uint16_t end, const uint8_t *nonce) {
+    uint8_t key[32];
+    uint8_t msg[36 + LEASE_NONCE_SIZE];
+    get_lease_key(key, N_appdata.slot);
+
+    memcpy(msg, N_KEY.sk.root, 32);
+    msg[32] = start >> 8;
+    msg[33] = start & 0xFF;
+    msg[34] = end >> 8;
+    msg[35] = end & 0xFF;
+    memcpy(msg + 36, nonce, LEASE_NONCE_SIZE);
+    cx_hmac_sha256(key, 32, msg, sizeof(msg), tag, 32);
+    os_memset(key, 0, 32);
+}
+
+// Range from the first 4 data bytes (start, end; big endian)
+void parse_lease_range(uint16_t *start, uint16_t *end, const uint8_t *data) {
+    *start = (data[0] << 8) + data[1];
+    *end = (data[2] << 8) + data[3];
+
+    if (*start >= *end || *end > 256) {
+        THROW(APDU_CODE_DATA_INVALID);
+    }
+}
+
+/// Nonce a lease for this device has to be issued for. A new request replaces the
+/// previous nonce, so tags issued for it can no longer be set
+void app_lease_request(volatile uint32_t *tx, uint32_t rx) {
+    if (rx < 5) {
+        THROW(APDU_CODE_WRONG_LENGTH);
+    }
+    if (N_appdata.mode != APPMODE_READY || ctx.sig_state != SIGSTATE_IDLE || lease_pending) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+
+    uint8_t nonce[LEASE_NONCE_SIZE];
+    cx_rng(nonce, LEASE_NONCE_SIZE);
+    nvm_write((void *) N_appdata.lease_nonce, nonce, LEASE_NONCE_SIZE);
+
+    os_memmove(G_io_apdu_buffer, nonce, LEASE_NONCE_SIZE);
+    *tx += LEASE_NONCE_SIZE;
+}
+
+/// Range and recipient nonce for a new lease, the tag is only returned once the user
+/// approves it. The range is split off the end of our own
+void parse_lease_issue(volatile uint32_t *tx, uint32_t rx) {
+    if (rx != 5 + 4 + LEASE_NONCE_SIZE) {
+        THROW(APDU_CODE_WRONG_LENGTH);
+    }
+    // the range shares ctx with the transaction under review
+    if (N_appdata.mode != APPMODE_READY || ctx.sig_state != SIGSTATE_IDLE || lease_pending) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+
+    parse_lease_range(&ctx.lease.start, &ctx.lease.end, G_io_apdu_buffer + 5);
+    // we keep at least one index, and a lease_end of 0 would mean no lease
+    if (ctx.lease.start <= N_appdata.xmss_index || ctx.lease.end > APP_INDEX_LIMIT) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+    memcpy(ctx.lease.nonce, G_io_apdu_buffer + 5 + 4, LEASE_NONCE_SIZE);
+    ctx.lease.slot = N_appdata.slot;
+    ctx.lease.key_generation = N_appdata.key_generation;
+    lease_pending = true;
+}
+
+/// The user approved: our range ends where the lease starts, then the tag goes out
+/// Returns 0 if the key or its index moved while the range was shown
+uint8_t app_lease_issue() {
+    lease_pending = false;
+    if (N_appdata.mode != APPMODE_READY ||
+        ctx.lease.slot != N_appdata.slot ||
+        ctx.lease.key_generation != N_appdata.key_generation) {
+        return 0;
+    }
+    if (ctx.lease.start <= N_appdata.xmss_index || ctx.lease.end > APP_INDEX_LIMIT) {
+        return 0;
+    }
+
+    nvm_write((void *) &N_appdata.lease_end, (void *) &ctx.lease.start, 2);
+    lease_tag(G_io_apdu_buffer, ctx.lease.start, ctx.lease.end, ctx.lease.nonce);
+    return 32;
+}
+
+/// The user rejected the range
+void app_lease_clear() {
+    lease_pending = false;
+}
+
+/// Takes a lease issued for this key and our last LEASE_REQUEST: the index moves forward
+/// to its start and no signature is made at or past its end
+void app_lease_set(volatile uint32_t *tx, uint32_t rx) {
+    if (rx != 5 + 4 + 32) {
+        THROW(APDU_CODE_WRONG_LENGTH);
+    }
+    if (N_appdata.mode != APPMODE_READY || ctx.sig_state != SIGSTATE_IDLE || lease_pending) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+
+    const uint8_t *data = G_io_apdu_buffer + 5;
+    uint16_t start;
+    uint16_t end;
+    parse_lease_range(&start, &end, data);
+
+    uint8_t nonce[LEASE_NONCE_SIZE];
+    uint8_t requested = 0;
+    memcpy(nonce, N_appdata.lease_nonce, LEASE_NONCE_SIZE);
+    for (uint8_t i = 0; i < LEASE_NONCE_SIZE; i++) {
+        requested |= nonce[i];
+    }
+    if (requested == 0) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+
+    uint8_t tag[32];
+    uint8_t diff = 0;
+    lease_tag(tag, start, end, nonce);
+    for (uint8_t i = 0; i < 32; i++) {
+        diff |= tag[i] ^ data[4 + i];
+    }
+    if (diff != 0) {
+        THROW(APDU_CODE_DATA_INVALID);
+    }
+
+    // indices below ours may already be used, here or by the previous lease
+    if (start < N_appdata.xmss_index) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+
+    // the nonce is used up first: an interrupted install loses the lease, it never
+    // takes it twice
+    os_memset(nonce, 0, LEASE_NONCE_SIZE);
+    nvm_write((void *) N_appdata.lease_nonce, nonce, LEASE_NONCE_SIZE);
+
+    appstorage_t tmp;
+    memcpy(tmp.raw_key, N_appdata.raw_key, sizeof(tmp.raw_key));
+    tmp.xmss_index = start;
+    tmp.lease_start = start;
+    tmp.lease_end = end;
+    nvm_write((void *) &N_appdata.raw_key, &tmp.raw_key, sizeof(tmp.raw_key));
+
+    app_sign_clear();
+    xmss_precomp_invalidate(&ctx.precomp);
+    view_update_state(500);
+}
+
 void parse_setidx(volatile uint32_t *tx, uint32_t rx) {
     if (rx != 6) {
         THROW(APDU_CODE_WRONG_LENGTH);
@@ -642,6 +1118,9 @@ void app_setidx() {
 
     const uint16_t tmp = ctx.new_idx;
     nvcpy((void *) &N_appdata.xmss_index, (void *) &tmp, 2);
+
+    app_sign_clear();
+    xmss_precomp_invalidate(&ctx.precomp);
     view_update_state(500);
 }
 
@@ -696,15 +1175,27 @@ void app_main() {
                     }
 
                     case INS_SIGN: {
-                        if (N_appdata.mode != APPMODE_READY) {
+                        // the transaction would overwrite the lease range on screen
+                        if (N_appdata.mode != APPMODE_READY || lease_pending) {
                             THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
                         }
 
-                        if (N_appdata.xmss_index >= 256) {
+                        parse_unsigned_message(&tx, rx);
+
+                        uint8_t msg[32];        // Used to store the tx hash
+                        hash_tx(msg);
+                        if (app_sign_replay(msg)) {
+                            THROW(APDU_CODE_OK);
+                        }
+                        // any other signature in progress is dropped
+                        app_sign_clear();
+
+                        // past the end of the key or of the leased range
+                        if (N_appdata.xmss_index >= APP_INDEX_LIMIT) {
                             THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
                         }
 
-                        parse_unsigned_message(&tx, rx);
+                        app_sign_speculate(msg);
 
                         view_sign_menu();
                         flags |= IO_ASYNCH_REPLY;
@@ -723,8 +1214,45 @@ void app_main() {
                         break;
                     }
 
+                    case INS_ROTATE_KEY: {
+                        app_rotate_key(&tx, rx);
+                        THROW(APDU_CODE_OK);
+                        break;
+                    }
+
+                    case INS_SELECT_SLOT: {
+                        app_select_slot(&tx, rx);
+                        THROW(APDU_CODE_OK);
+                        break;
+                    }
+
+                    case INS_SIGN_READ: {
+                        app_sign_read(&tx, rx);
+                        THROW(APDU_CODE_OK);
+                        break;
+                    }
+
+                    case INS_LEASE_ISSUE: {
+                        parse_lease_issue(&tx, rx);
+                        view_lease_show();
+                        flags |= IO_ASYNCH_REPLY;
+                        break;
+                    }
+
+                    case INS_LEASE_SET: {
+                        app_lease_set(&tx, rx);
+                        THROW(APDU_CODE_OK);
+                        break;
+                    }
+
+                    case INS_LEASE_REQUEST: {
+                        app_lease_request(&tx, rx);
+                        THROW(APDU_CODE_OK);
+                        break;
+                    }
+
                     case INS_SETIDX: {
-                        if (N_appdata.mode != APPMODE_READY) {
+                        if (N_appdata.mode != APPMODE_READY || lease_pending) {
                             THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
                         }
 
@@ -737,10 +1265,10 @@ void app_main() {
 #ifdef TESTING_ENABLED
                     case INS_TEST_PK_GEN_1: {
                         uint8_t seed[48];
-                        get_seed(seed);
+                        get_seed(seed, N_appdata.slot, N_appdata.key_generation);
 
-                        xmss_gen_keys_1_get_seeds(&N_DATA.sk, seed);
-                        os_memmove(G_io_apdu_buffer, N_DATA.sk.raw, 132);
+                        xmss_gen_keys_1_get_seeds(&N_KEY.sk, seed);
+                        os_memmove(G_io_apdu_buffer, N_KEY.sk.raw, 132);
                         tx+=132;
                         THROW(APDU_CODE_OK);
                         break;
@@ -804,6 +1332,12 @@ void app_main() {
                         THROW(APDU_CODE_OK);
                         break;
                     }
+
+                    case INS_TEST_CHUNK_COST: {
+                        test_chunk_costs(&tx, rx);
+                        THROW(APDU_CODE_OK);
+                        break;
+                    }
 #endif
                     default: {
                         THROW(APDU_CODE_INS_NOT_SUPPORTED);
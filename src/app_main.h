@@ -33,6 +33,14 @@ extern app_ctx_t ctx;
 #define INS_SIGN                0x04u
 #define INS_SIGN_NEXT           0x05u
 #define INS_SETIDX              0x06u
+#define INS_SIGN_READ           0x08u
+#define INS_ROTATE_KEY          0x0Au
+#define INS_SELECT_SLOT         0x0Bu
+#define INS_LEASE_ISSUE         0x0Cu
+#define INS_LEASE_SET           0x0Du
+#define INS_LEASE_REQUEST       0x0Eu
+
+#define SIGN_NEXT_AUTHPATH_DELTA 0x01    // P1 of SIGN_NEXT: only the changed auth path levels
 
 #define INS_TEST_PK_GEN_1       0x80
 #define INS_TEST_PK_GEN_2       0x81
@@ -44,11 +52,21 @@ extern app_ctx_t ctx;
 #define INS_TEST_SETSTATE       0x87
 #define INS_TEST_COMM           0x88
 #define INS_TEST_GETSEED        0x89
+#define INS_TEST_CHUNK_COST     0x8A    // Hash cost of each chunk of the last signature
 
 #define APPMODE_NOT_INITIALIZED    0x00
 #define APPMODE_KEYGEN_RUNNING     0x01
 #define APPMODE_READY              0x02
 
+#define KEYGEN_SLICE_COST          1024u    // hash cost per ticker event, about 16 chains
+#define KEYGEN_CHECKPOINT_LEAVES   16u      // leaves between N_appdata updates
+
+// Index from which the next key is generated in the background; with a lease the same
+// number of indices before the end of the range
+#ifndef KEY_SUCCESSOR_THRESHOLD
+#define KEY_SUCCESSOR_THRESHOLD    224u
+#endif
+
 void handler_init_device(unsigned int unused);
 
 void app_init();
@@ -57,6 +75,12 @@ void app_main();
 
 void app_sign();
 
+void app_sign_clear();
+
 void app_setidx();
 
+uint8_t app_lease_issue();
+
+void app_lease_clear();
+
 char app_initialize_xmss_step();
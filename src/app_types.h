@@ -17,11 +17,31 @@
 #include <stdint.h>
 #include "libxmss/xmss_types.h"
 #include "lib/qrl_types.h"
+#include "storage.h"
+
+#define SIGSTATE_IDLE       0
+#define SIGSTATE_REVIEW     1       // signing in the background, nothing can be read
+#define SIGSTATE_APPROVED   2       // index committed, chunks can be read
+#define SIGSTATE_REPLAY     3       // chunks of the stored signature of the same tx
 
 #pragma pack(push, 1)
 typedef union {
-    xmss_sig_ctx_t xmss_sig_ctx;
-    qrltx_t qrltx;
+    struct {
+        qrltx_t qrltx;              // shown while the signature is computed
+        uint8_t sig_state;
+        union {
+            xmss_sig_ctx_t xmss_sig_ctx;
+            xmss_keygen_ctx_t keygen;   // only while no signature is in progress
+        };
+        xmss_precomp_t precomp;     // seed and R of the current index, lost on reset
+    };
     uint16_t new_idx;
+    struct {
+        uint16_t start;
+        uint16_t end;
+        uint8_t nonce[LEASE_NONCE_SIZE];
+        uint8_t slot;               // key the range was checked against
+        uint32_t key_generation;
+    } lease;                        // range shown for approval before a lease tag is issued
 } app_ctx_t;
 #pragma pack(pop)
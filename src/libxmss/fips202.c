@@ -78,6 +78,7 @@ static const uint64_t KeccakF_RoundConstants_ledger[NROUNDS] =
                 (uint64_t) 0x8000000080008008ULL
         };
 
+#ifdef LEDGER_SPECIFIC
 /*************************************************
 * Name:        KeccakF1600_StatePermute
 *
@@ -350,6 +351,281 @@ void KeccakF1600_StatePermute_ledger(uint64_t* state)
 
 #undef    round
 }
+#else
+/*************************************************
+* Name:        KeccakF1600_StatePermute
+*
+* Description: The Keccak F1600 Permutation, host version
+*              Uses the lane complementing transform: six lanes are kept
+*              inverted during the rounds, which removes most NOT operations
+*              from chi (8 per round instead of 25). Two rounds per iteration.
+*
+* Arguments:   - uint64_t * state: pointer to in/output Keccak state
+**************************************************/
+void KeccakF1600_StatePermute_ledger(uint64_t* state)
+{
+    int round;
+
+    uint64_t Aba, Abe, Abi, Abo, Abu;
+    uint64_t Aga, Age, Agi, Ago, Agu;
+    uint64_t Aka, Ake, Aki, Ako, Aku;
+    uint64_t Ama, Ame, Ami, Amo, Amu;
+    uint64_t Asa, Ase, Asi, Aso, Asu;
+    uint64_t BCa, BCe, BCi, BCo, BCu;
+    uint64_t Da, De, Di, Do, Du;
+    uint64_t Eba, Ebe, Ebi, Ebo, Ebu;
+    uint64_t Ega, Ege, Egi, Ego, Egu;
+    uint64_t Eka, Eke, Eki, Eko, Eku;
+    uint64_t Ema, Eme, Emi, Emo, Emu;
+    uint64_t Esa, Ese, Esi, Eso, Esu;
+
+    //copyFromState(A, state), complementing Abe, Abi, Ago, Aki, Ami, Asa
+    Aba = state[0];
+    Abe = ~state[1];
+    Abi = ~state[2];
+    Abo = state[3];
+    Abu = state[4];
+    Aga = state[5];
+    Age = state[6];
+    Agi = state[7];
+    Ago = ~state[8];
+    Agu = state[9];
+    Aka = state[10];
+    Ake = state[11];
+    Aki = ~state[12];
+    Ako = state[13];
+    Aku = state[14];
+    Ama = state[15];
+    Ame = state[16];
+    Ami = ~state[17];
+    Amo = state[18];
+    Amu = state[19];
+    Asa = ~state[20];
+    Ase = state[21];
+    Asi = state[22];
+    Aso = state[23];
+    Asu = state[24];
+
+    for (round = 0; round<NROUNDS; round += 2) {
+        //    prepareTheta
+        BCa = Aba ^ Aga ^ Aka ^ Ama ^ Asa;
+        BCe = Abe ^ Age ^ Ake ^ Ame ^ Ase;
+        BCi = Abi ^ Agi ^ Aki ^ Ami ^ Asi;
+        BCo = Abo ^ Ago ^ Ako ^ Amo ^ Aso;
+        BCu = Abu ^ Agu ^ Aku ^ Amu ^ Asu;
+
+        //thetaRhoPiChiIota(round  , A, E)
+        Da = BCu ^ ROL(BCe, 1);
+        De = BCa ^ ROL(BCi, 1);
+        Di = BCe ^ ROL(BCo, 1);
+        Do = BCi ^ ROL(BCu, 1);
+        Du = BCo ^ ROL(BCa, 1);
+
+        Aba ^= Da;
+        BCa = Aba;
+        Age ^= De;
+        BCe = ROL(Age, 44);
+        Aki ^= Di;
+        BCi = ROL(Aki, 43);
+        Amo ^= Do;
+        BCo = ROL(Amo, 21);
+        Asu ^= Du;
+        BCu = ROL(Asu, 14);
+        Eba = BCa ^ (BCe | BCi);
+        Eba ^= (uint64_t) KeccakF_RoundConstants_ledger[round];
+        Ebe = BCe ^ ((~BCi) | BCo);
+        Ebi = BCi ^ (BCo & BCu);
+        Ebo = BCo ^ (BCu | BCa);
+        Ebu = BCu ^ (BCa & BCe);
+
+        Abo ^= Do;
+        BCa = ROL(Abo, 28);
+        Agu ^= Du;
+        BCe = ROL(Agu, 20);
+        Aka ^= Da;
+        BCi = ROL(Aka, 3);
+        Ame ^= De;
+        BCo = ROL(Ame, 45);
+        Asi ^= Di;
+        BCu = ROL(Asi, 61);
+        Ega = BCa ^ (BCe | BCi);
+        Ege = BCe ^ (BCi & BCo);
+        Egi = BCi ^ (BCo | (~BCu));
+        Ego = BCo ^ (BCu | BCa);
+        Egu = BCu ^ (BCa & BCe);
+
+        Abe ^= De;
+        BCa = ROL(Abe, 1);
+        Agi ^= Di;
+        BCe = ROL(Agi, 6);
+        Ako ^= Do;
+        BCi = ROL(Ako, 25);
+        Amu ^= Du;
+        BCo = ROL(Amu, 8);
+        Asa ^= Da;
+        BCu = ROL(Asa, 18);
+        Eka = BCa ^ (BCe | BCi);
+        Eke = BCe ^ (BCi & BCo);
+        Eki = BCi ^ ((~BCo) & BCu);
+        Eko = ~(BCo ^ (BCu | BCa));
+        Eku = BCu ^ (BCa & BCe);
+
+        Abu ^= Du;
+        BCa = ROL(Abu, 27);
+        Aga ^= Da;
+        BCe = ROL(Aga, 36);
+        Ake ^= De;
+        BCi = ROL(Ake, 10);
+        Ami ^= Di;
+        BCo = ROL(Ami, 15);
+        Aso ^= Do;
+        BCu = ROL(Aso, 56);
+        Ema = BCa ^ (BCe & BCi);
+        Eme = BCe ^ (BCi | BCo);
+        Emi = BCi ^ ((~BCo) | BCu);
+        Emo = ~(BCo ^ (BCu & BCa));
+        Emu = BCu ^ (BCa | BCe);
+
+        Abi ^= Di;
+        BCa = ROL(Abi, 62);
+        Ago ^= Do;
+        BCe = ROL(Ago, 55);
+        Aku ^= Du;
+        BCi = ROL(Aku, 39);
+        Ama ^= Da;
+        BCo = ROL(Ama, 41);
+        Ase ^= De;
+        BCu = ROL(Ase, 2);
+        Esa = BCa ^ ((~BCe) & BCi);
+        Ese = ~(BCe ^ (BCi | BCo));
+        Esi = BCi ^ (BCo & BCu);
+        Eso = BCo ^ (BCu | BCa);
+        Esu = BCu ^ (BCa & BCe);
+
+        //    prepareTheta
+        BCa = Eba ^ Ega ^ Eka ^ Ema ^ Esa;
+        BCe = Ebe ^ Ege ^ Eke ^ Eme ^ Ese;
+        BCi = Ebi ^ Egi ^ Eki ^ Emi ^ Esi;
+        BCo = Ebo ^ Ego ^ Eko ^ Emo ^ Eso;
+        BCu = Ebu ^ Egu ^ Eku ^ Emu ^ Esu;
+
+        //thetaRhoPiChiIota(round+1, E, A)
+        Da = BCu ^ ROL(BCe, 1);
+        De = BCa ^ ROL(BCi, 1);
+        Di = BCe ^ ROL(BCo, 1);
+        Do = BCi ^ ROL(BCu, 1);
+        Du = BCo ^ ROL(BCa, 1);
+
+        Eba ^= Da;
+        BCa = Eba;
+        Ege ^= De;
+        BCe = ROL(Ege, 44);
+        Eki ^= Di;
+        BCi = ROL(Eki, 43);
+        Emo ^= Do;
+        BCo = ROL(Emo, 21);
+        Esu ^= Du;
+        BCu = ROL(Esu, 14);
+        Aba = BCa ^ (BCe | BCi);
+        Aba ^= (uint64_t) KeccakF_RoundConstants_ledger[round + 1];
+        Abe = BCe ^ ((~BCi) | BCo);
+        Abi = BCi ^ (BCo & BCu);
+        Abo = BCo ^ (BCu | BCa);
+        Abu = BCu ^ (BCa & BCe);
+
+        Ebo ^= Do;
+        BCa = ROL(Ebo, 28);
+        Egu ^= Du;
+        BCe = ROL(Egu, 20);
+        Eka ^= Da;
+        BCi = ROL(Eka, 3);
+        Eme ^= De;
+        BCo = ROL(Eme, 45);
+        Esi ^= Di;
+        BCu = ROL(Esi, 61);
+        Aga = BCa ^ (BCe | BCi);
+        Age = BCe ^ (BCi & BCo);
+        Agi = BCi ^ (BCo | (~BCu));
+        Ago = BCo ^ (BCu | BCa);
+        Agu = BCu ^ (BCa & BCe);
+
+        Ebe ^= De;
+        BCa = ROL(Ebe, 1);
+        Egi ^= Di;
+        BCe = ROL(Egi, 6);
+        Eko ^= Do;
+        BCi = ROL(Eko, 25);
+        Emu ^= Du;
+        BCo = ROL(Emu, 8);
+        Esa ^= Da;
+        BCu = ROL(Esa, 18);
+        Aka = BCa ^ (BCe | BCi);
+        Ake = BCe ^ (BCi & BCo);
+        Aki = BCi ^ ((~BCo) & BCu);
+        Ako = ~(BCo ^ (BCu | BCa));
+        Aku = BCu ^ (BCa & BCe);
+
+        Ebu ^= Du;
+        BCa = ROL(Ebu, 27);
+        Ega ^= Da;
+        BCe = ROL(Ega, 36);
+        Eke ^= De;
+        BCi = ROL(Eke, 10);
+        Emi ^= Di;
+        BCo = ROL(Emi, 15);
+        Eso ^= Do;
+        BCu = ROL(Eso, 56);
+        Ama = BCa ^ (BCe & BCi);
+        Ame = BCe ^ (BCi | BCo);
+        Ami = BCi ^ ((~BCo) | BCu);
+        Amo = ~(BCo ^ (BCu & BCa));
+        Amu = BCu ^ (BCa | BCe);
+
+        Ebi ^= Di;
+        BCa = ROL(Ebi, 62);
+        Ego ^= Do;
+        BCe = ROL(Ego, 55);
+        Eku ^= Du;
+        BCi = ROL(Eku, 39);
+        Ema ^= Da;
+        BCo = ROL(Ema, 41);
+        Ese ^= De;
+        BCu = ROL(Ese, 2);
+        Asa = BCa ^ ((~BCe) & BCi);
+        Ase = ~(BCe ^ (BCi | BCo));
+        Asi = BCi ^ (BCo & BCu);
+        Aso = BCo ^ (BCu | BCa);
+        Asu = BCu ^ (BCa & BCe);
+    }
+
+    //copyToState(state, A), undoing the complement
+    state[0] = Aba;
+    state[1] = ~Abe;
+    state[2] = ~Abi;
+    state[3] = Abo;
+    state[4] = Abu;
+    state[5] = Aga;
+    state[6] = Age;
+    state[7] = Agi;
+    state[8] = ~Ago;
+    state[9] = Agu;
+    state[10] = Aka;
+    state[11] = Ake;
+    state[12] = ~Aki;
+    state[13] = Ako;
+    state[14] = Aku;
+    state[15] = Ama;
+    state[16] = Ame;
+    state[17] = ~Ami;
+    state[18] = Amo;
+    state[19] = Amu;
+    state[20] = ~Asa;
+    state[21] = Ase;
+    state[22] = Asi;
+    state[23] = Aso;
+    state[24] = Asu;
+}
+#endif
 
 #include <string.h>
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
@@ -539,3 +815,477 @@ void sha3_512_ledger(unsigned char* output, const unsigned char* input, unsigned
         output[i] = t[i];
 }
 
+/*************************************************
+* Name:        keccak_inc_init
+*
+* Description: Initializes the Keccak state for incremental absorbing
+*
+* Arguments:   - keccak_state *state: pointer to (uninitialized) Keccak state
+**************************************************/
+static void keccak_inc_init(keccak_state* state)
+{
+    unsigned int i;
+
+    for (i = 0; i<25; ++i)
+        state->s[i] = 0;
+    state->pos = 0;
+}
+
+/*************************************************
+* Name:        keccak_inc_absorb
+*
+* Description: Absorbs input into the Keccak state; can be called any number
+*              of times with inputs of any length, partial blocks are kept
+*              in the state until the next call or finalize.
+*
+* Arguments:   - keccak_state *state:     pointer to in/output Keccak state
+*              - unsigned int r:          rate in bytes
+*              - const unsigned char *m:  pointer to input
+*              - unsigned long long mlen: length of input in bytes
+**************************************************/
+static void keccak_inc_absorb(keccak_state* state, unsigned int r,
+        const unsigned char* m, unsigned long long mlen)
+{
+    unsigned int i;
+
+    // complete a pending partial block
+    while (mlen>0 && state->pos>0) {
+        state->s[state->pos/8] ^= (uint64_t) m[0] << 8*(state->pos%8);
+        state->pos++;
+        m++;
+        mlen--;
+        if (state->pos==r) {
+            KeccakF1600_StatePermute_ledger(state->s);
+            state->pos = 0;
+        }
+    }
+    if (mlen==0)
+        return;
+
+    while (mlen>=r) {
+        for (i = 0; i<r/8; ++i)
+            state->s[i] ^= load64(m+8*i);
+
+        KeccakF1600_StatePermute_ledger(state->s);
+        mlen -= r;
+        m += r;
+    }
+
+    for (i = 0; i<mlen; ++i)
+        state->s[i/8] ^= (uint64_t) m[i] << 8*(i%8);
+    state->pos = (unsigned int) mlen;
+}
+
+/*************************************************
+* Name:        keccak_inc_finalize
+*
+* Description: Applies the padding; afterwards the state can only be squeezed
+*
+* Arguments:   - keccak_state *state: pointer to in/output Keccak state
+*              - unsigned int r:      rate in bytes
+*              - unsigned char p:     domain-separation byte
+**************************************************/
+static void keccak_inc_finalize(keccak_state* state, unsigned int r, unsigned char p)
+{
+    state->s[state->pos/8] ^= (uint64_t) p << 8*(state->pos%8);
+    state->s[r/8-1] ^= (uint64_t) 128 << 56;
+    // nothing squeezed yet: the first squeeze permutes
+    state->pos = r;
+}
+
+/*************************************************
+* Name:        keccak_inc_squeeze
+*
+* Description: Squeezes any number of bytes; can be called multiple times,
+*              output continues where the previous call stopped.
+*
+* Arguments:   - unsigned char *h:        pointer to output
+*              - unsigned long long outlen: number of bytes to squeeze
+*              - keccak_state *state:     pointer to in/output Keccak state
+*              - unsigned int r:          rate in bytes
+**************************************************/
+static void keccak_inc_squeeze(unsigned char* h, unsigned long long outlen,
+        keccak_state* state, unsigned int r)
+{
+    while (outlen>0) {
+        if (state->pos==r) {
+            KeccakF1600_StatePermute_ledger(state->s);
+            state->pos = 0;
+        }
+        if (state->pos%8==0 && outlen>=8) {
+            store64(h, state->s[state->pos/8]);
+            state->pos += 8;
+            h += 8;
+            outlen -= 8;
+        } else {
+            *h++ = (unsigned char) (state->s[state->pos/8] >> 8*(state->pos%8));
+            state->pos++;
+            outlen--;
+        }
+    }
+}
+
+/*************************************************
+* Name:        shake256_init / shake256_absorb / shake256_finalize / shake256_squeeze
+*
+* Description: SHAKE256 XOF with incremental API. A state can be copied after
+*              absorbing a shared prefix and then finished independently.
+**************************************************/
+void shake256_init(keccak_state* state)
+{
+    keccak_inc_init(state);
+}
+
+void shake256_absorb(keccak_state* state, const unsigned char* input, unsigned long long inlen)
+{
+    keccak_inc_absorb(state, SHAKE256_RATE, input, inlen);
+}
+
+void shake256_finalize(keccak_state* state)
+{
+    keccak_inc_finalize(state, SHAKE256_RATE, 0x1F);
+}
+
+void shake256_squeeze(unsigned char* output, unsigned long long outlen, keccak_state* state)
+{
+    keccak_inc_squeeze(output, outlen, state, SHAKE256_RATE);
+}
+
+/*************************************************
+* Name:        sha3_256_init / sha3_256_absorb / sha3_256_finalize
+*
+* Description: SHA3-256 with incremental API; finalize writes the 32-byte digest
+**************************************************/
+void sha3_256_init(keccak_state* state)
+{
+    keccak_inc_init(state);
+}
+
+void sha3_256_absorb(keccak_state* state, const unsigned char* input, unsigned long long inlen)
+{
+    keccak_inc_absorb(state, SHA3_256_RATE, input, inlen);
+}
+
+void sha3_256_finalize(unsigned char* output, keccak_state* state)
+{
+    keccak_inc_finalize(state, SHA3_256_RATE, 0x06);
+    keccak_inc_squeeze(output, 32, state, SHA3_256_RATE);
+}
+
+/*************************************************
+* Name:        sha3_512_init / sha3_512_absorb / sha3_512_finalize
+*
+* Description: SHA3-512 with incremental API; finalize writes the 64-byte digest
+**************************************************/
+void sha3_512_init(keccak_state* state)
+{
+    keccak_inc_init(state);
+}
+
+void sha3_512_absorb(keccak_state* state, const unsigned char* input, unsigned long long inlen)
+{
+    keccak_inc_absorb(state, SHA3_512_RATE, input, inlen);
+}
+
+void sha3_512_finalize(unsigned char* output, keccak_state* state)
+{
+    keccak_inc_finalize(state, SHA3_512_RATE, 0x06);
+    keccak_inc_squeeze(output, 64, state, SHA3_512_RATE);
+}
+
+#ifdef FIPS202_X4_AVX2
+#include <immintrin.h>
+
+#define KECCAK_X4_TARGET __attribute__((target("avx2")))
+
+#define XORV(a, b)        _mm256_xor_si256(a, b)
+#define XOR5V(a, b, c, d, e) XORV(XORV(XORV(a, b), XORV(c, d)), e)
+#define ANDNOTV(a, b)     _mm256_andnot_si256(a, b)
+#define ROL64V(a, n)      _mm256_or_si256(_mm256_slli_epi64(a, n), _mm256_srli_epi64(a, 64 - (n)))
+// byte-aligned rotations are a single shuffle
+#define ROL64V_8(a)       _mm256_shuffle_epi8(a, _mm256_set_epi8(14, 13, 12, 11, 10, 9, 8, 15, 6, 5, 4, 3, 2, 1, 0, 7, \
+                                                                 14, 13, 12, 11, 10, 9, 8, 15, 6, 5, 4, 3, 2, 1, 0, 7))
+#define ROL64V_56(a)      _mm256_shuffle_epi8(a, _mm256_set_epi8(8, 15, 14, 13, 12, 11, 10, 9, 0, 7, 6, 5, 4, 3, 2, 1, \
+                                                                 8, 15, 14, 13, 12, 11, 10, 9, 0, 7, 6, 5, 4, 3, 2, 1))
+
+/*************************************************
+* Name:        KeccakF1600_StatePermute_x4
+*
+* Description: Four independent Keccak F1600 permutations, one per 64-bit AVX2 lane
+*
+* Arguments:   - uint64_t state[25][4]: lane i of the four states, interleaved
+**************************************************/
+KECCAK_X4_TARGET static void KeccakF1600_StatePermute_x4(uint64_t state[25][4])
+{
+    int round;
+
+    __m256i Aba, Abe, Abi, Abo, Abu;
+    __m256i Aga, Age, Agi, Ago, Agu;
+    __m256i Aka, Ake, Aki, Ako, Aku;
+    __m256i Ama, Ame, Ami, Amo, Amu;
+    __m256i Asa, Ase, Asi, Aso, Asu;
+    __m256i BCa, BCe, BCi, BCo, BCu;
+    __m256i Da, De, Di, Do, Du;
+    __m256i Eba, Ebe, Ebi, Ebo, Ebu;
+    __m256i Ega, Ege, Egi, Ego, Egu;
+    __m256i Eka, Eke, Eki, Eko, Eku;
+    __m256i Ema, Eme, Emi, Emo, Emu;
+    __m256i Esa, Ese, Esi, Eso, Esu;
+
+    Aba = _mm256_loadu_si256((const __m256i *) state[0]);
+    Abe = _mm256_loadu_si256((const __m256i *) state[1]);
+    Abi = _mm256_loadu_si256((const __m256i *) state[2]);
+    Abo = _mm256_loadu_si256((const __m256i *) state[3]);
+    Abu = _mm256_loadu_si256((const __m256i *) state[4]);
+    Aga = _mm256_loadu_si256((const __m256i *) state[5]);
+    Age = _mm256_loadu_si256((const __m256i *) state[6]);
+    Agi = _mm256_loadu_si256((const __m256i *) state[7]);
+    Ago = _mm256_loadu_si256((const __m256i *) state[8]);
+    Agu = _mm256_loadu_si256((const __m256i *) state[9]);
+    Aka = _mm256_loadu_si256((const __m256i *) state[10]);
+    Ake = _mm256_loadu_si256((const __m256i *) state[11]);
+    Aki = _mm256_loadu_si256((const __m256i *) state[12]);
+    Ako = _mm256_loadu_si256((const __m256i *) state[13]);
+    Aku = _mm256_loadu_si256((const __m256i *) state[14]);
+    Ama = _mm256_loadu_si256((const __m256i *) state[15]);
+    Ame = _mm256_loadu_si256((const __m256i *) state[16]);
+    Ami = _mm256_loadu_si256((const __m256i *) state[17]);
+    Amo = _mm256_loadu_si256((const __m256i *) state[18]);
+    Amu = _mm256_loadu_si256((const __m256i *) state[19]);
+    Asa = _mm256_loadu_si256((const __m256i *) state[20]);
+    Ase = _mm256_loadu_si256((const __m256i *) state[21]);
+    Asi = _mm256_loadu_si256((const __m256i *) state[22]);
+    Aso = _mm256_loadu_si256((const __m256i *) state[23]);
+    Asu = _mm256_loadu_si256((const __m256i *) state[24]);
+
+    for (round = 0; round<NROUNDS; round += 2) {
+        //    prepareTheta
+        BCa = XOR5V(Aba, Aga, Aka, Ama, Asa);
+        BCe = XOR5V(Abe, Age, Ake, Ame, Ase);
+        BCi = XOR5V(Abi, Agi, Aki, Ami, Asi);
+        BCo = XOR5V(Abo, Ago, Ako, Amo, Aso);
+        BCu = XOR5V(Abu, Agu, Aku, Amu, Asu);
+        Da = XORV(BCu, ROL64V(BCe, 1));
+        De = XORV(BCa, ROL64V(BCi, 1));
+        Di = XORV(BCe, ROL64V(BCo, 1));
+        Do = XORV(BCi, ROL64V(BCu, 1));
+        Du = XORV(BCo, ROL64V(BCa, 1));
+        BCa = XORV(Aba, Da);
+        BCe = ROL64V(XORV(Age, De), 44);
+        BCi = ROL64V(XORV(Aki, Di), 43);
+        BCo = ROL64V(XORV(Amo, Do), 21);
+        BCu = ROL64V(XORV(Asu, Du), 14);
+        Eba = XORV(BCa, ANDNOTV(BCe, BCi));
+        Eba = XORV(Eba, _mm256_set1_epi64x((long long) KeccakF_RoundConstants_ledger[round]));
+        Ebe = XORV(BCe, ANDNOTV(BCi, BCo));
+        Ebi = XORV(BCi, ANDNOTV(BCo, BCu));
+        Ebo = XORV(BCo, ANDNOTV(BCu, BCa));
+        Ebu = XORV(BCu, ANDNOTV(BCa, BCe));
+
+        BCa = ROL64V(XORV(Abo, Do), 28);
+        BCe = ROL64V(XORV(Agu, Du), 20);
+        BCi = ROL64V(XORV(Aka, Da), 3);
+        BCo = ROL64V(XORV(Ame, De), 45);
+        BCu = ROL64V(XORV(Asi, Di), 61);
+        Ega = XORV(BCa, ANDNOTV(BCe, BCi));
+        Ege = XORV(BCe, ANDNOTV(BCi, BCo));
+        Egi = XORV(BCi, ANDNOTV(BCo, BCu));
+        Ego = XORV(BCo, ANDNOTV(BCu, BCa));
+        Egu = XORV(BCu, ANDNOTV(BCa, BCe));
+
+        BCa = ROL64V(XORV(Abe, De), 1);
+        BCe = ROL64V(XORV(Agi, Di), 6);
+        BCi = ROL64V(XORV(Ako, Do), 25);
+        BCo = ROL64V_8(XORV(Amu, Du));
+        BCu = ROL64V(XORV(Asa, Da), 18);
+        Eka = XORV(BCa, ANDNOTV(BCe, BCi));
+        Eke = XORV(BCe, ANDNOTV(BCi, BCo));
+        Eki = XORV(BCi, ANDNOTV(BCo, BCu));
+        Eko = XORV(BCo, ANDNOTV(BCu, BCa));
+        Eku = XORV(BCu, ANDNOTV(BCa, BCe));
+
+        BCa = ROL64V(XORV(Abu, Du), 27);
+        BCe = ROL64V(XORV(Aga, Da), 36);
+        BCi = ROL64V(XORV(Ake, De), 10);
+        BCo = ROL64V(XORV(Ami, Di), 15);
+        BCu = ROL64V_56(XORV(Aso, Do));
+        Ema = XORV(BCa, ANDNOTV(BCe, BCi));
+        Eme = XORV(BCe, ANDNOTV(BCi, BCo));
+        Emi = XORV(BCi, ANDNOTV(BCo, BCu));
+        Emo = XORV(BCo, ANDNOTV(BCu, BCa));
+        Emu = XORV(BCu, ANDNOTV(BCa, BCe));
+
+        BCa = ROL64V(XORV(Abi, Di), 62);
+        BCe = ROL64V(XORV(Ago, Do), 55);
+        BCi = ROL64V(XORV(Aku, Du), 39);
+        BCo = ROL64V(XORV(Ama, Da), 41);
+        BCu = ROL64V(XORV(Ase, De), 2);
+        Esa = XORV(BCa, ANDNOTV(BCe, BCi));
+        Ese = XORV(BCe, ANDNOTV(BCi, BCo));
+        Esi = XORV(BCi, ANDNOTV(BCo, BCu));
+        Eso = XORV(BCo, ANDNOTV(BCu, BCa));
+        Esu = XORV(BCu, ANDNOTV(BCa, BCe));
+
+        //    prepareTheta
+        BCa = XOR5V(Eba, Ega, Eka, Ema, Esa);
+        BCe = XOR5V(Ebe, Ege, Eke, Eme, Ese);
+        BCi = XOR5V(Ebi, Egi, Eki, Emi, Esi);
+        BCo = XOR5V(Ebo, Ego, Eko, Emo, Eso);
+        BCu = XOR5V(Ebu, Egu, Eku, Emu, Esu);
+        Da = XORV(BCu, ROL64V(BCe, 1));
+        De = XORV(BCa, ROL64V(BCi, 1));
+        Di = XORV(BCe, ROL64V(BCo, 1));
+        Do = XORV(BCi, ROL64V(BCu, 1));
+        Du = XORV(BCo, ROL64V(BCa, 1));
+        BCa = XORV(Eba, Da);
+        BCe = ROL64V(XORV(Ege, De), 44);
+        BCi = ROL64V(XORV(Eki, Di), 43);
+        BCo = ROL64V(XORV(Emo, Do), 21);
+        BCu = ROL64V(XORV(Esu, Du), 14);
+        Aba = XORV(BCa, ANDNOTV(BCe, BCi));
+        Aba = XORV(Aba, _mm256_set1_epi64x((long long) KeccakF_RoundConstants_ledger[round + 1]));
+        Abe = XORV(BCe, ANDNOTV(BCi, BCo));
+        Abi = XORV(BCi, ANDNOTV(BCo, BCu));
+        Abo = XORV(BCo, ANDNOTV(BCu, BCa));
+        Abu = XORV(BCu, ANDNOTV(BCa, BCe));
+
+        BCa = ROL64V(XORV(Ebo, Do), 28);
+        BCe = ROL64V(XORV(Egu, Du), 20);
+        BCi = ROL64V(XORV(Eka, Da), 3);
+        BCo = ROL64V(XORV(Eme, De), 45);
+        BCu = ROL64V(XORV(Esi, Di), 61);
+        Aga = XORV(BCa, ANDNOTV(BCe, BCi));
+        Age = XORV(BCe, ANDNOTV(BCi, BCo));
+        Agi = XORV(BCi, ANDNOTV(BCo, BCu));
+        Ago = XORV(BCo, ANDNOTV(BCu, BCa));
+        Agu = XORV(BCu, ANDNOTV(BCa, BCe));
+
+        BCa = ROL64V(XORV(Ebe, De), 1);
+        BCe = ROL64V(XORV(Egi, Di), 6);
+        BCi = ROL64V(XORV(Eko, Do), 25);
+        BCo = ROL64V_8(XORV(Emu, Du));
+        BCu = ROL64V(XORV(Esa, Da), 18);
+        Aka = XORV(BCa, ANDNOTV(BCe, BCi));
+        Ake = XORV(BCe, ANDNOTV(BCi, BCo));
+        Aki = XORV(BCi, ANDNOTV(BCo, BCu));
+        Ako = XORV(BCo, ANDNOTV(BCu, BCa));
+        Aku = XORV(BCu, ANDNOTV(BCa, BCe));
+
+        BCa = ROL64V(XORV(Ebu, Du), 27);
+        BCe = ROL64V(XORV(Ega, Da), 36);
+        BCi = ROL64V(XORV(Eke, De), 10);
+        BCo = ROL64V(XORV(Emi, Di), 15);
+        BCu = ROL64V_56(XORV(Eso, Do));
+        Ama = XORV(BCa, ANDNOTV(BCe, BCi));
+        Ame = XORV(BCe, ANDNOTV(BCi, BCo));
+        Ami = XORV(BCi, ANDNOTV(BCo, BCu));
+        Amo = XORV(BCo, ANDNOTV(BCu, BCa));
+        Amu = XORV(BCu, ANDNOTV(BCa, BCe));
+
+        BCa = ROL64V(XORV(Ebi, Di), 62);
+        BCe = ROL64V(XORV(Ego, Do), 55);
+        BCi = ROL64V(XORV(Eku, Du), 39);
+        BCo = ROL64V(XORV(Ema, Da), 41);
+        BCu = ROL64V(XORV(Ese, De), 2);
+        Asa = XORV(BCa, ANDNOTV(BCe, BCi));
+        Ase = XORV(BCe, ANDNOTV(BCi, BCo));
+        Asi = XORV(BCi, ANDNOTV(BCo, BCu));
+        Aso = XORV(BCo, ANDNOTV(BCu, BCa));
+        Asu = XORV(BCu, ANDNOTV(BCa, BCe));
+    }
+
+    _mm256_storeu_si256((__m256i *) state[0], Aba);
+    _mm256_storeu_si256((__m256i *) state[1], Abe);
+    _mm256_storeu_si256((__m256i *) state[2], Abi);
+    _mm256_storeu_si256((__m256i *) state[3], Abo);
+    _mm256_storeu_si256((__m256i *) state[4], Abu);
+    _mm256_storeu_si256((__m256i *) state[5], Aga);
+    _mm256_storeu_si256((__m256i *) state[6], Age);
+    _mm256_storeu_si256((__m256i *) state[7], Agi);
+    _mm256_storeu_si256((__m256i *) state[8], Ago);
+    _mm256_storeu_si256((__m256i *) state[9], Agu);
+    _mm256_storeu_si256((__m256i *) state[10], Aka);
+    _mm256_storeu_si256((__m256i *) state[11], Ake);
+    _mm256_storeu_si256((__m256i *) state[12], Aki);
+    _mm256_storeu_si256((__m256i *) state[13], Ako);
+    _mm256_storeu_si256((__m256i *) state[14], Aku);
+    _mm256_storeu_si256((__m256i *) state[15], Ama);
+    _mm256_storeu_si256((__m256i *) state[16], Ame);
+    _mm256_storeu_si256((__m256i *) state[17], Ami);
+    _mm256_storeu_si256((__m256i *) state[18], Amo);
+    _mm256_storeu_si256((__m256i *) state[19], Amu);
+    _mm256_storeu_si256((__m256i *) state[20], Asa);
+    _mm256_storeu_si256((__m256i *) state[21], Ase);
+    _mm256_storeu_si256((__m256i *) state[22], Asi);
+    _mm256_storeu_si256((__m256i *) state[23], Aso);
+    _mm256_storeu_si256((__m256i *) state[24], Asu);
+}
+
+/*************************************************
+* Name:        keccak_x4
+*
+* Description: Four Keccak sponges over equal length inputs, absorb and squeeze
+*
+* Arguments:   - unsigned char *out[4]:      output buffers, outlen bytes each
+*              - const unsigned char *in[4]: inputs, inlen bytes each
+*              - unsigned int r:             rate in bytes
+*              - unsigned char p:            domain-separation byte
+**************************************************/
+KECCAK_X4_TARGET static void keccak_x4(unsigned char* out[4], unsigned long long outlen,
+        const unsigned char* in[4], unsigned long long inlen,
+        unsigned int r, unsigned char p)
+{
+    uint64_t s[25][4];
+    unsigned char t[4][200];
+    unsigned long long offset = 0;
+    unsigned int i, j;
+
+    memset(s, 0, sizeof(s));
+
+    while (inlen-offset>=r) {
+        for (i = 0; i<r/8; ++i)
+            for (j = 0; j<4; ++j)
+                s[i][j] ^= load64(in[j]+offset+8*i);
+        KeccakF1600_StatePermute_x4(s);
+        offset += r;
+    }
+
+    for (j = 0; j<4; ++j) {
+        memset(t[j], 0, r);
+        memcpy(t[j], in[j]+offset, inlen-offset);
+        t[j][inlen-offset] = p;
+        t[j][r-1] |= 128;
+        for (i = 0; i<r/8; ++i)
+            s[i][j] ^= load64(t[j]+8*i);
+    }
+
+    offset = 0;
+    while (offset<outlen) {
+        unsigned long long n = MIN(outlen-offset, r);
+        KeccakF1600_StatePermute_x4(s);
+        for (j = 0; j<4; ++j) {
+            for (i = 0; i<r/8; ++i)
+                store64(t[j]+8*i, s[i][j]);
+            memcpy(out[j]+offset, t[j], n);
+        }
+        offset += n;
+    }
+}
+
+/*************************************************
+* Name:        shake256_x4_avx2
+*
+* Description: Four SHAKE256 evaluations over equal length inputs, one per AVX2 lane.
+*              The caller checks that the CPU supports AVX2 (see hash_backend).
+*
+* Arguments:   - unsigned char *output[4]:      pointers to the four outputs
+*              - unsigned long long outlen:     requested output length in bytes
+*              - const unsigned char *input[4]: pointers to the four inputs
+*              - unsigned long long inlen:      length of each input in bytes
+**************************************************/
+KECCAK_X4_TARGET void shake256_x4_avx2(unsigned char* output[4], unsigned long long outlen,
+        const unsigned char* input[4], unsigned long long inlen)
+{
+    keccak_x4(output, outlen, input, inlen, SHAKE256_RATE, 0x1F);
+}
+#endif
@@ -8,6 +8,12 @@
 #define SHA3_256_RATE 136
 #define SHA3_512_RATE  72
 
+// State for the incremental API; plain data, so it can be copied to fork a hash
+typedef struct {
+    uint64_t s[25];
+    unsigned int pos;
+} keccak_state;
+
 void shake128_absorb(uint64_t *s, const unsigned char *input, unsigned int inputByteLen);
 void shake128_squeezeblocks(unsigned char *output, unsigned long long nblocks, uint64_t *s);
 
@@ -15,4 +21,24 @@ void shake256(unsigned char *output, unsigned long long outlen, const unsigned c
 void sha3_256(unsigned char *output, const unsigned char *input,  unsigned long long inlen);
 void sha3_512(unsigned char *output, const unsigned char *input,  unsigned long long inlen);
 
+void shake256_init(keccak_state *state);
+void shake256_absorb(keccak_state *state, const unsigned char *input, unsigned long long inlen);
+void shake256_finalize(keccak_state *state);
+void shake256_squeeze(unsigned char *output, unsigned long long outlen, keccak_state *state);
+
+void sha3_256_init(keccak_state *state);
+void sha3_256_absorb(keccak_state *state, const unsigned char *input, unsigned long long inlen);
+void sha3_256_finalize(unsigned char *output, keccak_state *state);
+
+void sha3_512_init(keccak_state *state);
+void sha3_512_absorb(keccak_state *state, const unsigned char *input, unsigned long long inlen);
+void sha3_512_finalize(unsigned char *output, keccak_state *state);
+
+#if !defined(LEDGER_SPECIFIC) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FIPS202_X4_AVX2
+// Four SHAKE256 hashes of equal length inputs, the CPU must support AVX2
+// Host code goes through hash_backend()->shake256_x4, which checks it
+void shake256_x4_avx2(unsigned char *output[4], unsigned long long outlen, const unsigned char *input[4], unsigned long long inlen);
+#endif
+
 #endif
@@ -0,0 +1,196 @@
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+#include "hash_backend.h"
+
+#ifndef LEDGER_SPECIFIC
+#include <string.h>
+#include <openssl/sha.h>
+#include <openssl/evp.h>
+#include "sha256mb.h"
+#include "fips202.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#define HASH_BACKEND_X86
+#endif
+
+void hash_midstate_init(hash_midstate_t *mid, const uint8_t prefix[64]) {
+    memcpy(mid->prefix, prefix, 64);
+    sha256mb_prefix(mid->state, prefix, 64);
+}
+
+////////////////////////////
+// Portable
+
+static void portable_sha256(uint8_t *out, const uint8_t *in, uint16_t in_len) {
+    sha256mb_portable(&out, NULL, 0, &in, in_len, 1);
+}
+
+static void portable_sha256_xN(uint8_t *out[], const uint8_t *in[], uint16_t in_len, uint16_t n) {
+    sha256mb_portable(out, NULL, 0, in, in_len, n);
+}
+
+static void portable_prf_xN(uint8_t *out[], const hash_midstate_t *mid, const uint8_t *in[], uint16_t n) {
+    sha256mb_portable(out, mid->state, 64, in, 32, n);
+}
+
+static void portable_shake256(uint8_t *out, uint64_t out_len, const uint8_t *in, uint64_t in_len) {
+    shake256(out, out_len, in, in_len);
+}
+
+static void portable_shake256_x4(uint8_t *out[4], uint64_t out_len, const uint8_t *in[4], uint64_t in_len) {
+    for (uint8_t i = 0; i < 4; i++) {
+        shake256(out[i], out_len, in[i], in_len);
+    }
+}
+
+////////////////////////////
+// OpenSSL
+
+static void openssl_sha256(uint8_t *out, const uint8_t *in, uint16_t in_len) {
+    SHA256(in, in_len, out);
+}
+
+static void openssl_sha256_xN(uint8_t *out[], const uint8_t *in[], uint16_t in_len, uint16_t n) {
+    for (uint16_t i = 0; i < n; i++) {
+        SHA256(in[i], in_len, out[i]);
+    }
+}
+
+static void openssl_prf_xN(uint8_t *out[], const hash_midstate_t *mid, const uint8_t *in[], uint16_t n) {
+    uint8_t buffer[96];
+    memcpy(buffer, mid->prefix, 64);
+    for (uint16_t i = 0; i < n; i++) {
+        memcpy(buffer + 64, in[i], 32);
+        SHA256(buffer, 96, out[i]);
+    }
+}
+
+static void openssl_shake256(uint8_t *out, uint64_t out_len, const uint8_t *in, uint64_t in_len) {
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    if (ctx == NULL ||
+        EVP_DigestInit_ex(ctx, EVP_shake256(), NULL) != 1 ||
+        EVP_DigestUpdate(ctx, in, in_len) != 1 ||
+        EVP_DigestFinalXOF(ctx, out, out_len) != 1) {
+        // never leave the output undefined
+        shake256(out, out_len, in, in_len);
+    }
+    EVP_MD_CTX_free(ctx);
+}
+
+static void openssl_shake256_x4(uint8_t *out[4], uint64_t out_len, const uint8_t *in[4], uint64_t in_len) {
+    for (uint8_t i = 0; i < 4; i++) {
+        openssl_shake256(out[i], out_len, in[i], in_len);
+    }
+}
+
+#ifdef HASH_BACKEND_X86
+////////////////////////////
+// SHA-NI
+
+static void shani_sha256(uint8_t *out, const uint8_t *in, uint16_t in_len) {
+    sha256mb_shani(&out, NULL, 0, &in, in_len, 1);
+}
+
+static void shani_sha256_xN(uint8_t *out[], const uint8_t *in[], uint16_t in_len, uint16_t n) {
+    sha256mb_shani(out, NULL, 0, in, in_len, n);
+}
+
+static void shani_prf_xN(uint8_t *out[], const hash_midstate_t *mid, const uint8_t *in[], uint16_t n) {
+    sha256mb_shani(out, mid->state, 64, in, 32, n);
+}
+
+////////////////////////////
+// AVX2 (single hashes have nothing to gain from lanes and stay on OpenSSL)
+
+static void avx2_sha256_xN(uint8_t *out[], const uint8_t *in[], uint16_t in_len, uint16_t n) {
+    sha256mb_avx2(out, NULL, 0, in, in_len, n);
+}
+
+static void avx2_prf_xN(uint8_t *out[], const hash_midstate_t *mid, const uint8_t *in[], uint16_t n) {
+    sha256mb_avx2(out, mid->state, 64, in, 32, n);
+}
+
+static void avx2_shake256_x4(uint8_t *out[4], uint64_t out_len, const uint8_t *in[4], uint64_t in_len) {
+    shake256_x4_avx2(out, out_len, in, in_len);
+}
+#endif
+
+// Ordered by preference
+static const hash_backend_t hash_backends[] = {
+#ifdef HASH_BACKEND_X86
+    // SHA-NI does not imply AVX2
+    {"shani", shani_sha256, shani_sha256_xN, shani_prf_xN, openssl_shake256, openssl_shake256_x4},
+    {"avx2", openssl_sha256, avx2_sha256_xN, avx2_prf_xN, openssl_shake256, avx2_shake256_x4},
+#endif
+    {"openssl", openssl_sha256, openssl_sha256_xN, openssl_prf_xN, openssl_shake256, openssl_shake256_x4},
+    {"portable", portable_sha256, portable_sha256_xN, portable_prf_xN, portable_shake256, portable_shake256_x4},
+};
+
+#define HASH_BACKEND_COUNT  (sizeof(hash_backends) / sizeof(hash_backends[0]))
+
+static const hash_backend_t *hash_backend_current = NULL;
+
+static bool hash_backend_supported(const hash_backend_t *backend) {
+#ifdef HASH_BACKEND_X86
+    unsigned int eax, ebx, ecx, edx;
+    unsigned int ecx1 = 0;
+    if (__get_cpuid(1, &eax, &ebx, &ecx1, &edx) == 0) {
+        ecx1 = 0;
+    }
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) == 0) {
+        ebx = 0;
+    }
+
+    if (strcmp(backend->name, "shani") == 0) {
+        return (ebx & bit_SHA) && (ecx1 & bit_SSSE3) && (ecx1 & bit_SSE4_1);
+    }
+
+    if (strcmp(backend->name, "avx2") == 0) {
+        if (!(ebx & bit_AVX2) || !(ecx1 & bit_OSXSAVE)) {
+            return false;
+        }
+        // the OS must save the YMM registers
+        uint32_t xcr0_lo, xcr0_hi;
+        __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        (void) xcr0_hi;
+        return (xcr0_lo & 6u) == 6u;
+    }
+#endif
+    (void) backend;
+    return true;
+}
+
+const hash_backend_t *hash_backend(void) {
+    if (hash_backend_current == NULL) {
+        for (uint8_t i = 0; i < HASH_BACKEND_COUNT; i++) {
+            if (hash_backend_supported(&hash_backends[i])) {
+                hash_backend_current = &hash_backends[i];
+                break;
+            }
+        }
+    }
+    return hash_backend_current;
+}
+
+uint8_t hash_backend_count(void) {
+    return HASH_BACKEND_COUNT;
+}
+
+const hash_backend_t *hash_backend_get(uint8_t i) {
+    if (i >= HASH_BACKEND_COUNT || !hash_backend_supported(&hash_backends[i])) {
+        return NULL;
+    }
+    return &hash_backends[i];
+}
+
+bool hash_backend_select(const char *name) {
+    for (uint8_t i = 0; i < HASH_BACKEND_COUNT; i++) {
+        if (strcmp(hash_backends[i].name, name) == 0 && hash_backend_supported(&hash_backends[i])) {
+            hash_backend_current = &hash_backends[i];
+            return true;
+        }
+    }
+    return false;
+}
+#endif
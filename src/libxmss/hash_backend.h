@@ -0,0 +1,49 @@
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zxmacros.h"
+
+// Host-side hash backends, selected at runtime from the CPU features
+// The device always uses the cx_* syscalls and never goes through this table
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifndef LEDGER_SPECIFIC
+// Compressed state of a 64-byte prefix
+// The raw prefix is kept as well for backends that cannot resume from a midstate
+typedef struct {
+  uint32_t state[8];
+  uint8_t prefix[64];
+} hash_midstate_t;
+
+typedef struct {
+  const char *name;
+  void (*sha256)(uint8_t *out, const uint8_t *in, uint16_t in_len);
+  // n independent hashes of in_len bytes each
+  void (*sha256_xN)(uint8_t *out[], const uint8_t *in[], uint16_t in_len, uint16_t n);
+  // n hashes of prefix || in[i], with 32-byte in[i]
+  void (*prf_xN)(uint8_t *out[], const hash_midstate_t *mid, const uint8_t *in[], uint16_t n);
+  void (*shake256)(uint8_t *out, uint64_t out_len, const uint8_t *in, uint64_t in_len);
+  // 4 independent hashes of in_len bytes each
+  void (*shake256_x4)(uint8_t *out[4], uint64_t out_len, const uint8_t *in[4], uint64_t in_len);
+} hash_backend_t;
+
+void hash_midstate_init(hash_midstate_t *mid, const uint8_t prefix[64]);
+
+// Backend in use. The fastest supported one is picked on first use
+const hash_backend_t *hash_backend(void);
+
+// Enumeration and explicit selection, used to benchmark backends side by side
+uint8_t hash_backend_count(void);
+const hash_backend_t *hash_backend_get(uint8_t i);
+bool hash_backend_select(const char *name);
+#endif
+
+#ifdef  __cplusplus
+}
+#endif
@@ -8,11 +8,24 @@
 extern "C" {
 #endif
 
+// One XMSS tree: seeds, leaves and the internal nodes built from them
 typedef struct {
   xmss_sk_t sk;
-  xmss_signature_t signature;
-  uint8_t wots_buffer[WOTS_LEN * WOTS_N];
+  xmss_tree_stack_t stack;
   uint8_t xmss_nodes[XMSS_NODES_BUFSIZE];
+  xmss_tree_cache_t xmss_tree;
+} N_KEY_t;
+
+#ifndef XMSS_KEY_SLOTS
+#define XMSS_KEY_SLOTS  1u                          // keys the host can select, 16 KB of NV each
+#endif
+#define N_KEY_BUFFERS   (XMSS_KEY_SLOTS + 1u)       // plus a spare for a successor key
+
+typedef struct {
+  N_KEY_t key[N_KEY_BUFFERS];
+  xmss_signature_t signature;
+  uint8_t signature_msg[32];        // tx hash signed by signature
+  uint8_t signature_ready;          // signature holds the complete last signature
 } N_DATA_t;
 
 extern NVCONST N_DATA_t N_DATA_impl;
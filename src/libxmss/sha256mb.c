@@ -0,0 +1,361 @@
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+#include "sha256mb.h"
+
+#ifndef LEDGER_SPECIFIC
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define SHA256MB_X86
+#endif
+
+#define SHA256MB_MAX_LANES  SHA256MB_AVX2_LANES
+
+// Compresses one 64-byte block per lane. Blocks for unused lanes are never read
+typedef void (*sha256mb_kernel_t)(uint32_t state[][8], const uint8_t *const *blocks, uint8_t lanes);
+
+static const uint32_t sha256_iv[8] = {
+        0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au,
+        0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u
+};
+
+static const uint32_t sha256_k[64] = {
+        0x428a2f98u, 0x71374491u, 0xb5c0fbcfu, 0xe9b5dba5u, 0x3956c25bu, 0x59f111f1u, 0x923f82a4u, 0xab1c5ed5u,
+        0xd807aa98u, 0x12835b01u, 0x243185beu, 0x550c7dc3u, 0x72be5d74u, 0x80deb1feu, 0x9bdc06a7u, 0xc19bf174u,
+        0xe49b69c1u, 0xefbe4786u, 0x0fc19dc6u, 0x240ca1ccu, 0x2de92c6fu, 0x4a7484aau, 0x5cb0a9dcu, 0x76f988dau,
+        0x983e5152u, 0xa831c66du, 0xb00327c8u, 0xbf597fc7u, 0xc6e00bf3u, 0xd5a79147u, 0x06ca6351u, 0x14292967u,
+        0x27b70a85u, 0x2e1b2138u, 0x4d2c6dfcu, 0x53380d13u, 0x650a7354u, 0x766a0abbu, 0x81c2c92eu, 0x92722c85u,
+        0xa2bfe8a1u, 0xa81a664bu, 0xc24b8b70u, 0xc76c51a3u, 0xd192e819u, 0xd6990624u, 0xf40e3585u, 0x106aa070u,
+        0x19a4c116u, 0x1e376c08u, 0x2748774cu, 0x34b0bcb5u, 0x391c0cb3u, 0x4ed8aa4au, 0x5b9cca4fu, 0x682e6ff3u,
+        0x748f82eeu, 0x78a5636fu, 0x84c87814u, 0x8cc70208u, 0x90befffau, 0xa4506cebu, 0xbef9a3f7u, 0xc67178f2u
+};
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32u - (n))))
+
+__INLINE uint32_t load_be32(const uint8_t *p) {
+    return ((uint32_t) p[0] << 24u) | ((uint32_t) p[1] << 16u) | ((uint32_t) p[2] << 8u) | p[3];
+}
+
+__INLINE void store_be32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t) (v >> 24u);
+    p[1] = (uint8_t) (v >> 16u);
+    p[2] = (uint8_t) (v >> 8u);
+    p[3] = (uint8_t) v;
+}
+
+static void sha256mb_kernel_portable(uint32_t state[][8], const uint8_t *const *blocks, uint8_t lanes) {
+    for (uint8_t l = 0; l < lanes; l++) {
+        uint32_t w[64];
+        uint32_t *s = state[l];
+
+        for (uint8_t t = 0; t < 16; t++) {
+            w[t] = load_be32(blocks[l] + 4 * t);
+        }
+        for (uint8_t t = 16; t < 64; t++) {
+            const uint32_t s0 = ROR32(w[t - 15], 7) ^ ROR32(w[t - 15], 18) ^ (w[t - 15] >> 3u);
+            const uint32_t s1 = ROR32(w[t - 2], 17) ^ ROR32(w[t - 2], 19) ^ (w[t - 2] >> 10u);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+
+        uint32_t a = s[0], b = s[1], c = s[2], d = s[3];
+        uint32_t e = s[4], f = s[5], g = s[6], h = s[7];
+
+        for (uint8_t t = 0; t < 64; t++) {
+            const uint32_t t1 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) +
+                                ((e & f) ^ (~e & g)) + sha256_k[t] + w[t];
+            const uint32_t t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) +
+                                ((a & b) | (c & (a | b)));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        s[0] += a;
+        s[1] += b;
+        s[2] += c;
+        s[3] += d;
+        s[4] += e;
+        s[5] += f;
+        s[6] += g;
+        s[7] += h;
+    }
+}
+
+#ifdef SHA256MB_X86
+// Kernels are compiled for their instruction set only; callers check the CPU before using them
+#define AVX2_TARGET  __attribute__((target("avx2")))
+#define SHANI_TARGET __attribute__((target("sha,ssse3,sse4.1")))
+
+#define AVX2_ROR(x, n)  _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+#define AVX2_ADD(x, y)  _mm256_add_epi32(x, y)
+#define AVX2_XOR(x, y)  _mm256_xor_si256(x, y)
+
+// Transposes 8 rows of 8 words so that row i holds word i of every lane
+AVX2_TARGET static inline void sha256mb_transpose_avx2(__m256i r[8]) {
+    const __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    const __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    const __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    const __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    const __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    const __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    const __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    const __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+    const __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    const __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    const __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    const __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    const __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    const __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    const __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    const __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+// 8 independent blocks, one per 32-bit lane. All 8 block pointers must be valid
+AVX2_TARGET static void sha256mb_kernel_avx2(uint32_t state[][8], const uint8_t *const *blocks, uint8_t lanes) {
+    (void) lanes;
+    const __m256i bswap = _mm256_set_epi8(
+            12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+            12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m256i s[8], w[16];
+
+    for (uint8_t i = 0; i < 8; i++) {
+        s[i] = _mm256_loadu_si256((const __m256i *) state[i]);
+        w[i] = _mm256_loadu_si256((const __m256i *) blocks[i]);
+        w[i + 8] = _mm256_loadu_si256((const __m256i *) (blocks[i] + 32));
+    }
+    sha256mb_transpose_avx2(s);
+    sha256mb_transpose_avx2(w);
+    sha256mb_transpose_avx2(w + 8);
+    for (uint8_t i = 0; i < 16; i++) {
+        w[i] = _mm256_shuffle_epi8(w[i], bswap);
+    }
+
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+    __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (uint8_t t = 0; t < 64; t++) {
+        if (t >= 16) {
+            const __m256i w15 = w[(t - 15) & 15u];
+            const __m256i w2 = w[(t - 2) & 15u];
+            const __m256i s0 = AVX2_XOR(AVX2_XOR(AVX2_ROR(w15, 7), AVX2_ROR(w15, 18)), _mm256_srli_epi32(w15, 3));
+            const __m256i s1 = AVX2_XOR(AVX2_XOR(AVX2_ROR(w2, 17), AVX2_ROR(w2, 19)), _mm256_srli_epi32(w2, 10));
+            w[t & 15u] = AVX2_ADD(AVX2_ADD(w[t & 15u], s0), AVX2_ADD(w[(t - 7) & 15u], s1));
+        }
+
+        const __m256i ch = AVX2_XOR(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        const __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        const __m256i S1 = AVX2_XOR(AVX2_XOR(AVX2_ROR(e, 6), AVX2_ROR(e, 11)), AVX2_ROR(e, 25));
+        const __m256i S0 = AVX2_XOR(AVX2_XOR(AVX2_ROR(a, 2), AVX2_ROR(a, 13)), AVX2_ROR(a, 22));
+
+        const __m256i kw = AVX2_ADD(_mm256_set1_epi32((int) sha256_k[t]), w[t & 15u]);
+        const __m256i t1 = AVX2_ADD(AVX2_ADD(h, S1), AVX2_ADD(ch, kw));
+        const __m256i t2 = AVX2_ADD(S0, maj);
+
+        h = g;
+        g = f;
+        f = e;
+        e = AVX2_ADD(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = AVX2_ADD(t1, t2);
+    }
+
+    s[0] = AVX2_ADD(s[0], a);
+    s[1] = AVX2_ADD(s[1], b);
+    s[2] = AVX2_ADD(s[2], c);
+    s[3] = AVX2_ADD(s[3], d);
+    s[4] = AVX2_ADD(s[4], e);
+    s[5] = AVX2_ADD(s[5], f);
+    s[6] = AVX2_ADD(s[6], g);
+    s[7] = AVX2_ADD(s[7], h);
+
+    sha256mb_transpose_avx2(s);
+    for (uint8_t i = 0; i < 8; i++) {
+        _mm256_storeu_si256((__m256i *) state[i], s[i]);
+    }
+}
+
+
+// Up to 2 blocks; lanes are interleaved to hide the latency of sha256rnds2
+SHANI_TARGET static void sha256mb_kernel_shani(uint32_t state[][8], const uint8_t *const *blocks, uint8_t lanes) {
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i abef[SHA256MB_SHANI_LANES], cdgh[SHA256MB_SHANI_LANES];
+    __m128i abef_save[SHA256MB_SHANI_LANES], cdgh_save[SHA256MB_SHANI_LANES];
+    __m128i m[SHA256MB_SHANI_LANES][4];
+
+    for (uint8_t l = 0; l < lanes; l++) {
+        const __m128i dcba = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[l][0]), 0xB1);
+        const __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[l][4]), 0x1B);
+        abef[l] = abef_save[l] = _mm_alignr_epi8(dcba, efgh, 8);
+        cdgh[l] = cdgh_save[l] = _mm_blend_epi16(efgh, dcba, 0xF0);
+
+        for (uint8_t i = 0; i < 4; i++) {
+            m[l][i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (blocks[l] + 16 * i)), bswap);
+        }
+    }
+
+    for (uint8_t i = 0; i < 16; i++) {
+        const __m128i k = _mm_loadu_si128((const __m128i *) &sha256_k[4 * i]);
+
+        for (uint8_t l = 0; l < lanes; l++) {
+            if (i >= 4) {
+                const __m128i w7 = _mm_alignr_epi8(m[l][(i - 1) & 3u], m[l][(i - 2) & 3u], 4);
+                const __m128i w16 = _mm_sha256msg1_epu32(m[l][i & 3u], m[l][(i - 3) & 3u]);
+                m[l][i & 3u] = _mm_sha256msg2_epu32(_mm_add_epi32(w16, w7), m[l][(i - 1) & 3u]);
+            }
+
+            __m128i msg = _mm_add_epi32(m[l][i & 3u], k);
+            cdgh[l] = _mm_sha256rnds2_epu32(cdgh[l], abef[l], msg);
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            abef[l] = _mm_sha256rnds2_epu32(abef[l], cdgh[l], msg);
+        }
+    }
+
+    for (uint8_t l = 0; l < lanes; l++) {
+        const __m128i feba = _mm_shuffle_epi32(_mm_add_epi32(abef[l], abef_save[l]), 0x1B);
+        const __m128i dchg = _mm_shuffle_epi32(_mm_add_epi32(cdgh[l], cdgh_save[l]), 0xB1);
+        _mm_storeu_si128((__m128i *) &state[l][0], _mm_blend_epi16(feba, dchg, 0xF0));
+        _mm_storeu_si128((__m128i *) &state[l][4], _mm_alignr_epi8(dchg, feba, 8));
+    }
+}
+#endif
+
+// Hashes up to `width` messages of the same length with the given kernel
+// Every lane starts from `iv`, after `prefix_len` bytes have already been compressed
+// Missing lanes reuse the first message and their output is dropped
+static void sha256mb_lanes(sha256mb_kernel_t kernel,
+                           uint8_t width,
+                           uint8_t *out[],
+                           const uint32_t *iv,
+                           uint16_t prefix_len,
+                           const uint8_t *in[],
+                           uint16_t in_len,
+                           uint8_t count) {
+    uint32_t state[SHA256MB_MAX_LANES][8];
+    uint8_t tail[SHA256MB_MAX_LANES][128];
+    const uint8_t *blocks[SHA256MB_MAX_LANES];
+
+    const uint16_t full_blocks = in_len / 64u;
+    const uint8_t rem = (uint8_t) (in_len % 64u);
+    const uint8_t tail_blocks = rem + 9u > 64u ? 2 : 1;
+    const uint64_t bits = ((uint64_t) prefix_len + in_len) << 3u;
+
+    for (uint8_t l = 0; l < count; l++) {
+        memset(tail[l], 0, 128);
+        memcpy(tail[l], in[l] + 64u * full_blocks, rem);
+        tail[l][rem] = 0x80;
+        for (uint8_t i = 0; i < 8; i++) {
+            tail[l][64u * tail_blocks - 1u - i] = (uint8_t) (bits >> (8u * i));
+        }
+    }
+
+    for (uint8_t l = 0; l < width; l++) {
+        memcpy(state[l], iv, 8 * sizeof(uint32_t));
+    }
+
+    for (uint16_t b = 0; b < full_blocks; b++) {
+        for (uint8_t l = 0; l < width; l++) {
+            blocks[l] = in[l < count ? l : 0] + 64u * b;
+        }
+        kernel(state, blocks, count);
+    }
+
+    for (uint8_t b = 0; b < tail_blocks; b++) {
+        for (uint8_t l = 0; l < width; l++) {
+            blocks[l] = tail[l < count ? l : 0] + 64u * b;
+        }
+        kernel(state, blocks, count);
+    }
+
+    for (uint8_t l = 0; l < count; l++) {
+        for (uint8_t i = 0; i < 8; i++) {
+            store_be32(out[l] + 4 * i, state[l][i]);
+        }
+    }
+}
+
+void sha256mb_prefix(uint32_t state[8], const uint8_t *prefix, uint16_t prefix_len) {
+    memcpy(state, sha256_iv, sizeof(sha256_iv));
+    for (uint16_t b = 0; b < prefix_len / 64u; b++) {
+        const uint8_t *block = prefix + 64u * b;
+        sha256mb_kernel_portable((uint32_t (*)[8]) state, &block, 1);
+    }
+}
+
+// Every message of the batch goes through `kernel` in groups of `width` lanes
+// Groups with fewer than `min_lanes` messages are hashed one by one with the portable kernel
+static void sha256mb_run(sha256mb_kernel_t kernel,
+                         uint8_t width,
+                         uint8_t min_lanes,
+                         uint8_t *out[],
+                         const uint32_t state[8],
+                         uint16_t prefix_len,
+                         const uint8_t *in[],
+                         uint16_t in_len,
+                         uint16_t count) {
+    if (state == NULL) {
+        state = sha256_iv;
+        prefix_len = 0;
+    }
+
+    while (count > 0) {
+        uint8_t lanes = count < width ? (uint8_t) count : width;
+        if (lanes < min_lanes) {
+            lanes = 1;
+            sha256mb_lanes(sha256mb_kernel_portable, 1, out, state, prefix_len, in, in_len, lanes);
+        } else {
+            sha256mb_lanes(kernel, width, out, state, prefix_len, in, in_len, lanes);
+        }
+        out += lanes;
+        in += lanes;
+        count -= lanes;
+    }
+}
+
+void sha256mb_portable(uint8_t *out[],
+                       const uint32_t state[8],
+                       uint16_t prefix_len,
+                       const uint8_t *in[],
+                       uint16_t in_len,
+                       uint16_t count) {
+    sha256mb_run(sha256mb_kernel_portable, 1, 1, out, state, prefix_len, in, in_len, count);
+}
+
+#ifdef SHA256MB_X86
+void sha256mb_avx2(uint8_t *out[],
+                   const uint32_t state[8],
+                   uint16_t prefix_len,
+                   const uint8_t *in[],
+                   uint16_t in_len,
+                   uint16_t count) {
+    // a partially filled group is still cheaper than 3 scalar hashes
+    sha256mb_run(sha256mb_kernel_avx2, SHA256MB_AVX2_LANES, 3, out, state, prefix_len, in, in_len, count);
+}
+
+void sha256mb_shani(uint8_t *out[],
+                    const uint32_t state[8],
+                    uint16_t prefix_len,
+                    const uint8_t *in[],
+                    uint16_t in_len,
+                    uint16_t count) {
+    sha256mb_run(sha256mb_kernel_shani, SHA256MB_SHANI_LANES, 1, out, state, prefix_len, in, in_len, count);
+}
+#endif
+#endif
@@ -0,0 +1,50 @@
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+#pragma once
+
+#include <stdint.h>
+#include "zxmacros.h"
+
+// Multi-buffer SHA-256 for host builds
+// All messages in a batch have the same length so they can be hashed in lockstep
+#define SHA256MB_AVX2_LANES   8u
+#define SHA256MB_SHANI_LANES  2u
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifndef LEDGER_SPECIFIC
+// Compresses a common prefix (multiple of 64 bytes) once so batches can resume from it
+void sha256mb_prefix(uint32_t state[8], const uint8_t *prefix, uint16_t prefix_len);
+
+// Hashes `count` messages of in_len bytes each, resuming from `state` after prefix_len bytes
+// A NULL state starts from the SHA-256 IV
+void sha256mb_portable(uint8_t *out[],
+                       const uint32_t state[8],
+                       uint16_t prefix_len,
+                       const uint8_t *in[],
+                       uint16_t in_len,
+                       uint16_t count);
+
+#if defined(__x86_64__)
+// Only call these after checking the CPU supports them (see hash_backend.c)
+void sha256mb_avx2(uint8_t *out[],
+                   const uint32_t state[8],
+                   uint16_t prefix_len,
+                   const uint8_t *in[],
+                   uint16_t in_len,
+                   uint16_t count);
+
+void sha256mb_shani(uint8_t *out[],
+                    const uint32_t state[8],
+                    uint16_t prefix_len,
+                    const uint8_t *in[],
+                    uint16_t in_len,
+                    uint16_t count);
+#endif
+#endif
+
+#ifdef  __cplusplus
+}
+#endif
@@ -106,13 +106,18 @@ __INLINE void __sha256(uint8_t *out, const uint8_t* in, uint16_t in_len)
 
 #else
 
-#include <openssl/sha.h>
+#include "hash_backend.h"
 __INLINE void __sha256(uint8_t *out, const uint8_t *in, uint16_t in_len) {
-    SHA256(in, in_len, out);
+    hash_backend()->sha256(out, in, in_len);
 }
 
 #endif
 
+// Batches are split in groups of this size when input pointers need to be rebased
+#define SHASH_XN_GROUP      8u
+// Tree nodes hashed per batch by shash_h_xN
+#define SHASH_H_GROUP       32u
+
 __INLINE void shash96(uint8_t *out, const shash_input_t *in) {
     __sha256(out, in->raw, 96);
 }
@@ -125,39 +130,184 @@ __INLINE void shash160(uint8_t *out, const hashh_t *in) {
     __sha256(out, in->raw, 160);
 }
 
-__INLINE void hash_f(uint8_t *in_out, shash_input_t *shash_in) {
-    shash_input_t h_in;
-    PRF_init(&h_in, SHASH_TYPE_F);
+// Multi-buffer variants: n independent hashes of the same length
+// On the device they fall back to sequential hashing
+__INLINE void shash96_xN(uint8_t *out[], const shash_input_t *in[], uint16_t n) {
+#ifdef LEDGER_SPECIFIC
+    for (uint16_t i = 0; i < n; i++) {
+        shash96(out[i], in[i]);
+    }
+#else
+    hash_backend()->sha256_xN(out, (const uint8_t **) in, 96, n);
+#endif
+}
+
+__INLINE void shash128_shifted_xN(uint8_t *out[], const hashh_t *in[], uint16_t n) {
+#ifdef LEDGER_SPECIFIC
+    for (uint16_t i = 0; i < n; i++) {
+        shash128_shifted(out[i], in[i]);
+    }
+#else
+    for (uint16_t i = 0; i < n; i += SHASH_XN_GROUP) {
+        const uint8_t *p[SHASH_XN_GROUP];
+        uint16_t count = n - i;
+        if (count > SHASH_XN_GROUP) {
+            count = SHASH_XN_GROUP;
+        }
+        for (uint16_t j = 0; j < count; j++) {
+            p[j] = in[i + j]->shifted_raw;
+        }
+        hash_backend()->sha256_xN(out + i, p, 128, count);
+    }
+#endif
+}
+
+__INLINE void shash160_xN(uint8_t *out[], const hashh_t *in[], uint16_t n) {
+#ifdef LEDGER_SPECIFIC
+    for (uint16_t i = 0; i < n; i++) {
+        shash160(out[i], in[i]);
+    }
+#else
+    hash_backend()->sha256_xN(out, (const uint8_t **) in, 160, n);
+#endif
+}
+
+// PRF with a fixed 64-byte prefix (type block + key)
+// The prefix is compressed once and every call only hashes the remaining 32 bytes
+#pragma pack(push, 1)
+typedef struct {
+#ifdef LEDGER_SPECIFIC
+  cx_sha256_t sha;
+#else
+  hash_midstate_t mid;
+#endif
+} shash_prf_t;
+#pragma pack(pop)
 
-    shash_in->adrs.keyAndMask = 0;
-    shash96(h_in.key, shash_in);
+__INLINE void shash_prf_init(shash_prf_t *prf, const uint8_t *key) {
+    uint8_t prefix[64];
+    memset(prefix, 0, 32);
+    prefix[31] = SHASH_TYPE_PRF;
+    memcpy(prefix + 32, key, WOTS_N);
 
-    shash_in->adrs.keyAndMask = HtoNL(1u);
-    shash96(h_in.F.mask, shash_in);
+#ifdef LEDGER_SPECIFIC
+    // contexts are copied through the stack so the syscalls always get an aligned one
+    cx_sha256_t sha;
+    cx_sha256_init(&sha);
+    cx_hash(&sha.header, 0, prefix, 64, NULL, 0);
+    memcpy(&prf->sha, &sha, sizeof(cx_sha256_t));
+#else
+    hash_midstate_t mid;
+    hash_midstate_init(&mid, prefix);
+    memcpy(&prf->mid, &mid, sizeof(hash_midstate_t));
+#endif
+}
 
-    memxor(h_in.F.mask, in_out, WOTS_N);
+__INLINE void shash_prf(uint8_t *out, const shash_prf_t *prf, const uint8_t *in) {
+#ifdef LEDGER_SPECIFIC
+    cx_sha256_t sha;
+    memcpy(&sha, &prf->sha, sizeof(cx_sha256_t));
+    cx_hash(&sha.header, CX_LAST, in, 32, out, 32);
+#else
+    hash_midstate_t mid;
+    memcpy(&mid, &prf->mid, sizeof(hash_midstate_t));
+    hash_backend()->prf_xN(&out, &mid, &in, 1);
+#endif
+}
 
-    shash96(in_out, &h_in);
+__INLINE void shash_prf_xN(uint8_t *out[], const shash_prf_t *prf, const uint8_t *in[], uint16_t n) {
+#ifdef LEDGER_SPECIFIC
+    for (uint16_t i = 0; i < n; i++) {
+        shash_prf(out[i], prf, in[i]);
+    }
+#else
+    hash_midstate_t mid;
+    memcpy(&mid, &prf->mid, sizeof(hash_midstate_t));
+    hash_backend()->prf_xN(out, &mid, in, n);
+#endif
 }
 
-__INLINE void shash_h(uint8_t *out, const uint8_t *in, hashh_t *hhash_in) {
-    hhash_in->basic.type[31] = SHASH_TYPE_PRF;
+__INLINE void shash_h(uint8_t *out, const uint8_t *in, const shash_prf_t *prf, union ADRS_t *adrs) {
+    hashh_t h_in;
 
-    hhash_in->basic.adrs.keyAndMask = HtoNL(1u);
-    shash96(hhash_in->bitmask1, &hhash_in->basic);
+#ifdef LEDGER_SPECIFIC
+    adrs->keyAndMask = HtoNL(1u);
+    shash_prf(h_in.bitmask1, prf, adrs->raw);
 
-    hhash_in->basic.adrs.keyAndMask = HtoNL(2u);
-    shash96(hhash_in->bitmask2, &hhash_in->basic);
+    adrs->keyAndMask = HtoNL(2u);
+    shash_prf(h_in.bitmask2, prf, adrs->raw);
 
     // Shifting hhash
-    hhash_in->basic.adrs.keyAndMask = HtoNL(0u);
-    shash96(hhash_in->shift.basic.key, &hhash_in->basic);
+    adrs->keyAndMask = HtoNL(0u);
+    shash_prf(h_in.shift.basic.key, prf, adrs->raw);
+#else
+    // The three PRF calls are independent
+    union ADRS_t prf_adrs[3];
+    const uint8_t *prf_p[3] = {prf_adrs[0].raw, prf_adrs[1].raw, prf_adrs[2].raw};
+    uint8_t *prf_out[3] = {h_in.bitmask1, h_in.bitmask2, h_in.shift.basic.key};
+
+    for (uint8_t i = 0; i < 3; i++) {
+        prf_adrs[i] = *adrs;
+        prf_adrs[i].keyAndMask = HtoNL((i + 1u) % 3u);
+    }
+    shash_prf_xN(prf_out, prf, prf_p, 3);
+#endif
+
+    memset(h_in.shift.basic.type, 0, WOTS_N);
+    h_in.shift.basic.type[31] = SHASH_TYPE_H;
 
-    memset(hhash_in->shift.basic.type, 0, WOTS_N);
-    hhash_in->shift.basic.type[31] = SHASH_TYPE_H;
+    memxor(h_in.bitmask1, in, WOTS_N);
+    memxor(h_in.bitmask2, in + WOTS_N, WOTS_N);
 
-    memxor(hhash_in->bitmask1, in, WOTS_N);
-    memxor(hhash_in->bitmask2, in + WOTS_N, WOTS_N);
+    shash128_shifted(out, &h_in);
+}
 
-    shash128_shifted(out, hhash_in);
+// Level-at-a-time node hashing: n independent nodes of the same tree level
+// Nodes are processed in groups, in order, and all inputs of a group are read before
+// its outputs are written, so the in-place level pattern out[i] = H(in[2i]) is safe
+__INLINE void shash_h_xN(uint8_t *out[],
+                         const uint8_t *in[],
+                         const shash_prf_t *prf,
+                         const union ADRS_t adrs[],
+                         uint16_t n) {
+#ifdef LEDGER_SPECIFIC
+    for (uint16_t i = 0; i < n; i++) {
+        union ADRS_t node_adrs = adrs[i];
+        shash_h(out[i], in[i], prf, &node_adrs);
+    }
+#else
+    for (uint16_t g = 0; g < n; g += SHASH_H_GROUP) {
+        hashh_t h_in[SHASH_H_GROUP];
+        union ADRS_t prf_adrs[3 * SHASH_H_GROUP];
+        const uint8_t *prf_p[3 * SHASH_H_GROUP];
+        uint8_t *prf_out[3 * SHASH_H_GROUP];
+        const hashh_t *h_p[SHASH_H_GROUP];
+
+        uint16_t count = n - g;
+        if (count > SHASH_H_GROUP) {
+            count = SHASH_H_GROUP;
+        }
+
+        for (uint16_t i = 0; i < count; i++) {
+            for (uint8_t k = 0; k < 3; k++) {
+                prf_adrs[3 * i + k] = adrs[g + i];
+                prf_adrs[3 * i + k].keyAndMask = HtoNL((k + 1u) % 3u);
+                prf_p[3 * i + k] = prf_adrs[3 * i + k].raw;
+            }
+            prf_out[3 * i] = h_in[i].bitmask1;
+            prf_out[3 * i + 1] = h_in[i].bitmask2;
+            prf_out[3 * i + 2] = h_in[i].shift.basic.key;
+            h_p[i] = &h_in[i];
+        }
+        shash_prf_xN(prf_out, prf, prf_p, 3 * count);
+
+        for (uint16_t i = 0; i < count; i++) {
+            memset(h_in[i].shift.basic.type, 0, WOTS_N);
+            h_in[i].shift.basic.type[31] = SHASH_TYPE_H;
+            memxor(h_in[i].bitmask1, in[g + i], WOTS_N);
+            memxor(h_in[i].bitmask2, in[g + i] + WOTS_N, WOTS_N);
+        }
+        shash128_shifted_xN(out + g, h_p, count);
+    }
+#endif
 }
@@ -2,49 +2,195 @@
 // file LICENSE or http://www.opensource.org/licenses/mit-license.php.
 #include "wotsp.h"
 
+__INLINE void wotsp_seed_input(uint8_t *in, uint8_t chain) {
+    // PRF input for the secret of a chain: 31 zero bytes and the chain index
+    memset(in, 0, 32);
+    in[31] = chain;
+}
+
 void wotsp_expand_seed(NVCONST uint8_t *pk, const uint8_t *seed) {
-    shash_input_t prf_input;
-    PRF_init(&prf_input, SHASH_TYPE_PRF);
+    shash_prf_t prf;
+    shash_prf_init(&prf, seed);
 
-    memcpy(prf_input.key, seed, WOTS_N);
-    for (; prf_input.seed_gen.cdr < WOTS_LEN;
-           prf_input.seed_gen.cdr++, pk += WOTS_N) {
+#ifdef LEDGER_SPECIFIC
+    for (uint8_t i = 0; i < WOTS_LEN; i++, pk += WOTS_N) {
+        uint8_t in[32];
         uint8_t tmp[32];
-        shash96(tmp, &prf_input);
+        wotsp_seed_input(in, i);
+        shash_prf(tmp, &prf, in);
         nvcpy(pk, tmp, 32);
     }
+#else
+    uint8_t in[WOTS_LEN][32];
+    const uint8_t *in_p[WOTS_LEN];
+    uint8_t *out_p[WOTS_LEN];
+
+    for (uint8_t i = 0; i < WOTS_LEN; i++) {
+        wotsp_seed_input(in[i], i);
+        in_p[i] = in[i];
+        out_p[i] = pk + WOTS_N * i;
+    }
+    shash_prf_xN(out_p, &prf, in_p, WOTS_LEN);
+#endif
 }
 
-__INLINE void wotsp_gen_chain_mem(uint8_t *in_out, shash_input_t *prf_input, uint8_t start, int8_t count) {
-    prf_input->adrs.otshash.hash = HtoNL(start);
-    for (uint8_t i = start; i < start + count && i < WOTS_W; i++) {
-        hash_f(in_out, prf_input);
-        BE_inc(&prf_input->adrs.otshash.hash);
+void wots_chain(uint8_t *out,
+                const uint8_t *in,
+                const shash_prf_t *prf,
+                const union ADRS_t *adrs_template,
+                uint8_t start,
+                uint8_t steps) {
+    // Word-aligned views of every hash input. Only the hash word of the adrs changes per step
+    union {
+      uint32_t w[8];
+      union ADRS_t adrs;
+    } key_adrs, mask_adrs;
+    union {
+      uint32_t w[24];
+      shash_input_t in;
+    } f_in;
+    union {
+      uint32_t w[8];
+      uint8_t raw[32];
+    } value;
+
+    memcpy(value.raw, in, WOTS_N);
+    memcpy(key_adrs.adrs.raw, adrs_template->raw, 32);
+    memcpy(mask_adrs.adrs.raw, adrs_template->raw, 32);
+    key_adrs.adrs.keyAndMask = 0;
+    mask_adrs.adrs.keyAndMask = HtoNL(1u);
+    PRF_init(&f_in.in, SHASH_TYPE_F);
+
+    const uint8_t end = start + steps < WOTS_W ? start + steps : WOTS_W;
+    for (uint8_t i = start; i < end; i++) {
+        key_adrs.adrs.otshash.hash = HtoNL(i);
+        mask_adrs.adrs.otshash.hash = key_adrs.adrs.otshash.hash;
+
+#ifdef LEDGER_SPECIFIC
+        shash_prf(f_in.in.key, prf, key_adrs.adrs.raw);
+        shash_prf(f_in.in.F.mask, prf, mask_adrs.adrs.raw);
+#else
+        const uint8_t *prf_p[2] = {key_adrs.adrs.raw, mask_adrs.adrs.raw};
+        uint8_t *prf_out[2] = {f_in.in.key, f_in.in.F.mask};
+        shash_prf_xN(prf_out, prf, prf_p, 2);
+#endif
+
+        for (uint8_t j = 0; j < 8; j++) {
+            f_in.w[16 + j] ^= value.w[j];
+        }
+        shash96(value.raw, &f_in.in);
     }
+
+    memcpy(out, value.raw, WOTS_N);
 }
 
-void wotsp_gen_chain(NVCONST uint8_t *in_out, shash_input_t *prf_input, uint8_t start, int8_t count) {
+void wotsp_chain_secret(uint8_t *out, const shash_prf_t *seed_prf, uint8_t chain) {
+    uint8_t seed_in[32];
+    wotsp_seed_input(seed_in, chain);
+    shash_prf(out, seed_prf, seed_in);
+}
+
+void wotsp_gen_chain(NVCONST uint8_t *in_out,
+                     const shash_prf_t *prf,
+                     const union ADRS_t *adrs,
+                     uint8_t start,
+                     int8_t count) {
     uint8_t tmp[32];
-    memcpy(tmp, in_out, 32);
-    wotsp_gen_chain_mem(tmp, prf_input, start, count);
+    wots_chain(tmp, in_out, prf, adrs, start, (uint8_t) count);
     nvcpy(in_out, tmp, 32);
 }
 
+void wotsp_gen_pk_chain(uint8_t *out,
+                        const shash_prf_t *seed_prf,
+                        const shash_prf_t *pub_prf,
+                        uint16_t index,
+                        uint8_t chain) {
+    wotsp_chain_secret(out, seed_prf, chain);
+
+    union ADRS_t adrs;
+    memset(adrs.raw, 0, 32);
+    adrs.otshash.OTS = HtoNL(index);
+    adrs.otshash.chain = HtoNL(chain);
+    wots_chain(out, out, pub_prf, &adrs, 0, WOTS_W - 1);
+}
+
+#ifndef LEDGER_SPECIFIC
+// All chains advance in lockstep so each step is a single multi-buffer batch
+// Chain c joins at hash index start[c]; chains are ordered by start so the active
+// ones at every step are a prefix of the batch
+static void wotsp_gen_chains_lockstep(uint8_t *pk,
+                                      const shash_prf_t *prf,
+                                      const union ADRS_t *adrs,
+                                      const uint8_t start[WOTS_LEN]) {
+    union ADRS_t prf_adrs[2 * WOTS_LEN];
+    shash_input_t f_in[WOTS_LEN];
+    const uint8_t *prf_p[2 * WOTS_LEN];
+    const shash_input_t *f_p[WOTS_LEN];
+    uint8_t *prf_out[2 * WOTS_LEN];
+    uint8_t *f_out[WOTS_LEN];
+    uint8_t active[WOTS_W];
+
+    uint8_t n = 0;
+    for (uint8_t s = 0; s < WOTS_W; s++) {
+        for (uint8_t c = 0; c < WOTS_LEN; c++) {
+            if (start[c] != s) {
+                continue;
+            }
+            // even entries derive the key, odd entries the mask
+            for (uint8_t k = 0; k < 2; k++) {
+                union ADRS_t *p = &prf_adrs[2 * n + k];
+                *p = *adrs;
+                p->otshash.chain = HtoNL(c);
+                p->keyAndMask = HtoNL(k);
+                prf_p[2 * n + k] = p->raw;
+            }
+
+            PRF_init(&f_in[n], SHASH_TYPE_F);
+            prf_out[2 * n] = f_in[n].key;
+            prf_out[2 * n + 1] = f_in[n].F.mask;
+            f_p[n] = &f_in[n];
+            f_out[n] = pk + WOTS_N * c;
+            n++;
+        }
+        active[s] = n;
+    }
+
+    for (uint8_t i = 0; i < WOTS_W - 1; i++) {
+        const uint8_t count = active[i];
+        for (uint8_t j = 0; j < 2 * count; j++) {
+            prf_adrs[j].otshash.hash = HtoNL(i);
+        }
+        shash_prf_xN(prf_out, prf, prf_p, 2 * count);
+
+        for (uint8_t c = 0; c < count; c++) {
+            memxor(f_in[c].F.mask, f_out[c], WOTS_N);
+        }
+        shash96_xN(f_out, f_p, count);
+    }
+}
+#endif
+
 void wotsp_gen_pk(NVCONST uint8_t *pk, uint8_t *sk, const uint8_t *pub_seed, uint16_t index) {
     wotsp_expand_seed(pk, sk);
 
-    shash_input_t prf_input;
-    PRF_init(&prf_input, SHASH_TYPE_PRF);
-    memcpy(prf_input.key, pub_seed, WOTS_N);
+    shash_prf_t prf;
+    shash_prf_init(&prf, pub_seed);
 
-    ADRS_init(&prf_input.adrs, 0);
-    prf_input.adrs.otshash.OTS = HtoNL(index);
+    union ADRS_t adrs;
+    memset(adrs.raw, 0, 32);
+    adrs.otshash.OTS = HtoNL(index);
 
-    while (NtoHL(prf_input.adrs.otshash.chain) < WOTS_LEN) {
-        wotsp_gen_chain(pk, &prf_input, 0, WOTS_W - 1);
-        BE_inc(&prf_input.adrs.otshash.chain);
+#ifdef LEDGER_SPECIFIC
+    while (NtoHL(adrs.otshash.chain) < WOTS_LEN) {
+        wotsp_gen_chain(pk, &prf, &adrs, 0, WOTS_W - 1);
+        BE_inc(&adrs.otshash.chain);
         pk += WOTS_N;
     }
+#else
+    uint8_t start[WOTS_LEN];
+    memset(start, 0, WOTS_LEN);
+    wotsp_gen_chains_lockstep(pk, &prf, &adrs, start);
+#endif
 }
 
 void wotsp_sign_init_ctx(
@@ -52,28 +198,29 @@ void wotsp_sign_init_ctx(
     const uint8_t *pub_seed,
     const uint8_t *sk,
     uint16_t index) {
-    PRF_init(&ctx->prf_input1, SHASH_TYPE_PRF);
-    ctx->prf_input1.adrs.otshash.OTS = NtoHL(index);
-    memcpy(ctx->prf_input1.key, pub_seed, WOTS_N);
+    memset(ctx->adrs.raw, 0, 32);
+    ctx->adrs.otshash.OTS = NtoHL(index);
+    shash_prf_init(&ctx->pub_prf, pub_seed);
 
     ctx->bits = 0;      // init context
     ctx->csum = 0;
     ctx->in = 0;
     ctx->total = 0;
 
-    PRF_init(&ctx->prf_input2, SHASH_TYPE_PRF);
-    memcpy(ctx->prf_input2.key, sk, WOTS_N);
+    shash_prf_init(&ctx->seed_prf, sk);
 }
 
 void wotsp_sign_step(
     wots_sign_ctx_t *ctx,
     uint8_t *out_sig_p,
     const uint8_t *msg) {
-    shash96(out_sig_p, &ctx->prf_input2);
+    const uint8_t chain = (uint8_t) NtoHL(ctx->adrs.otshash.chain);
+
+    wotsp_chain_secret(out_sig_p, &ctx->seed_prf, chain);
 
     if (ctx->bits == 0) {
         ctx->bits += 8;
-        if (NtoHL(ctx->prf_input1.adrs.otshash.chain) < WOTS_LEN1) {
+        if (chain < WOTS_LEN1) {
             ctx->total = msg[ctx->in++];
         } else {
             ctx->total = ctx->csum;
@@ -83,10 +230,9 @@ void wotsp_sign_step(
 
     ctx->bits -= 4;
     const uint8_t basew_i = (uint8_t) ((ctx->total >> ctx->bits) & 0x0Fu);
-    wotsp_gen_chain_mem(out_sig_p, &ctx->prf_input1, 0, basew_i);
+    wots_chain(out_sig_p, out_sig_p, &ctx->pub_prf, &ctx->adrs, 0, basew_i);
     ctx->csum += (0x0Fu - basew_i);
-    BE_inc(&ctx->prf_input1.adrs.otshash.chain);
-    ctx->prf_input2.seed_gen.cdr++;
+    BE_inc(&ctx->adrs.otshash.chain);
 }
 
 void wotsp_sign(
@@ -101,7 +247,46 @@ void wotsp_sign(
     wotsp_sign_init_ctx(&ctx, pub_seed, sk, index);
 
     while (!wotsp_sign_ready(&ctx)) {
-        uint8_t *p = out_sig + WOTS_N * ctx.prf_input2.seed_gen.cdr;
+        uint8_t *p = out_sig + WOTS_N * NtoHL(ctx.adrs.otshash.chain);
         wotsp_sign_step(&ctx, p, msg);
     }
 }
+
+void wotsp_basew_digits(uint8_t digits[WOTS_LEN], const uint8_t *msg) {
+    uint32_t csum = 0;
+    for (uint8_t i = 0; i < WOTS_LEN1 / 2; i++) {
+        digits[2 * i] = msg[i] >> 4u;
+        digits[2 * i + 1] = msg[i] & 0x0Fu;
+        csum += (0x0Fu - digits[2 * i]) + (0x0Fu - digits[2 * i + 1]);
+    }
+
+    // checksum digits, most significant first (same order as wotsp_sign_step)
+    for (uint8_t i = 0; i < WOTS_LEN - WOTS_LEN1; i++) {
+        const uint8_t shift = (uint8_t) (4u * (WOTS_LEN - WOTS_LEN1 - 1u - i));
+        digits[WOTS_LEN1 + i] = (uint8_t) ((csum >> shift) & 0x0Fu);
+    }
+}
+
+void wotsp_pk_from_sig(uint8_t *pk,
+                       const uint8_t *sig,
+                       const uint8_t *msg,
+                       const shash_prf_t *prf,
+                       uint16_t index) {
+    uint8_t digits[WOTS_LEN];
+    wotsp_basew_digits(digits, msg);
+
+    union ADRS_t adrs;
+    memset(adrs.raw, 0, 32);
+    adrs.otshash.OTS = HtoNL(index);
+
+#ifdef LEDGER_SPECIFIC
+    for (uint8_t c = 0; c < WOTS_LEN; c++) {
+        adrs.otshash.chain = HtoNL(c);
+        wots_chain(pk + WOTS_N * c, sig + WOTS_N * c, prf, &adrs, digits[c], WOTS_W - 1 - digits[c]);
+    }
+#else
+    // every chain finishes the steps the signer did not do
+    memcpy(pk, sig, WOTS_LEN * WOTS_N);
+    wotsp_gen_chains_lockstep(pk, prf, &adrs, digits);
+#endif
+}
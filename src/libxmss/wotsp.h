@@ -14,8 +14,9 @@ typedef struct {
   uint32_t total;
   uint32_t in;
   uint8_t bits;
-  shash_input_t prf_input1;
-  shash_input_t prf_input2;
+  union ADRS_t adrs;
+  shash_prf_t pub_prf;
+  shash_prf_t seed_prf;
 } wots_sign_ctx_t;
 #pragma pack(pop)
 
@@ -23,7 +24,31 @@ __INLINE void BE_inc(uint32_t *val) { *val = NtoHL(HtoNL(*val) + 1); }
 
 void wotsp_expand_seed(NVCONST uint8_t *pk, const uint8_t *seed);
 
-void wotsp_gen_chain(NVCONST uint8_t *in_out, shash_input_t *prf_input, uint8_t start, int8_t count);
+// Advances a chain value `steps` times starting at hash index `start`
+// adrs_template provides the OTS and chain words; in and out may alias
+void wots_chain(uint8_t *out,
+                const uint8_t *in,
+                const shash_prf_t *prf,
+                const union ADRS_t *adrs_template,
+                uint8_t start,
+                uint8_t steps);
+
+// Secret (chain start) of one chain, seed_prf is keyed with the per-index seed
+void wotsp_chain_secret(uint8_t *out, const shash_prf_t *seed_prf, uint8_t chain);
+
+void wotsp_gen_chain(NVCONST uint8_t *in_out,
+                     const shash_prf_t *prf,
+                     const union ADRS_t *adrs,
+                     uint8_t start,
+                     int8_t count);
+
+// One element of the public key: derives the chain secret and runs the full chain
+// Used to stream the public key into the L-tree without storing it
+void wotsp_gen_pk_chain(uint8_t *out,
+                        const shash_prf_t *seed_prf,
+                        const shash_prf_t *pub_prf,
+                        uint16_t index,
+                        uint8_t chain);
 
 void wotsp_gen_pk(NVCONST uint8_t *pk, uint8_t *sk, const uint8_t *pub_seed, uint16_t index);
 
@@ -32,7 +57,18 @@ void wotsp_sign_init_ctx(wots_sign_ctx_t *ctx, const uint8_t *pub_seed, const ui
 void wotsp_sign_step(wots_sign_ctx_t *ctx, uint8_t *out_sig_p, const uint8_t *msg);
 
 __INLINE bool wotsp_sign_ready(wots_sign_ctx_t *ctx) {
-    return WOTS_LEN <= NtoHL(ctx->prf_input1.adrs.otshash.chain);
+    return WOTS_LEN <= NtoHL(ctx->adrs.otshash.chain);
 }
 
 void wotsp_sign(uint8_t *out_sig, const uint8_t *msg, const uint8_t *pub_seed, const uint8_t *sk, uint16_t index);
+
+// Base-w (w=16) digits of a 32-byte message followed by the checksum digits
+void wotsp_basew_digits(uint8_t digits[WOTS_LEN], const uint8_t *msg);
+
+// Recovers the WOTS+ public key from a signature by finishing every chain
+// prf is the pub_seed PRF, so verifiers can share it across signatures of a key
+void wotsp_pk_from_sig(uint8_t *pk,
+                       const uint8_t *sig,
+                       const uint8_t *msg,
+                       const shash_prf_t *prf,
+                       uint16_t index);
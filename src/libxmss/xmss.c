@@ -4,15 +4,29 @@
 
 #define BUF_MAX_IDX 34      // split point between ram and nvram
 
+// Approximate SHA-256 compressions per operation, used to balance signature chunks and keygen slices
+#define XMSS_COST_PRF           1u
+#define XMSS_COST_CHAIN_STEP    4u      // two PRFs and F
+#define XMSS_COST_NODE          6u      // three PRFs and H
+#define XMSS_COST_CHAIN         (XMSS_COST_PRF + (WOTS_W - 1) * XMSS_COST_CHAIN_STEP)
+
 __INLINE uint8_t *get_p(NVCONST uint8_t *tmp_wotspk, uint8_t *mem_wotspk, uint32_t idx) {
     uint8_t *base_p = idx < BUF_MAX_IDX ? (uint8_t *) mem_wotspk : (uint8_t *) tmp_wotspk;
     return base_p + WOTS_N * idx;
 }
 
-void xmss_ltree_gen(NVCONST uint8_t *leaf,
-                    NVCONST uint8_t *tmp_wotspk,
-                    const uint8_t *pub_seed,
-                    uint16_t index) {
+__INLINE void xmss_node_adrs(union ADRS_t *adrs, uint32_t type, uint16_t ltree, uint8_t height, uint16_t index) {
+    memset(adrs->raw, 0, 32);
+    adrs->type = HtoNL(type);
+    adrs->trees.ltree = HtoNL(ltree);
+    adrs->trees.height = HtoNL(height);
+    adrs->trees.index = HtoNL(index);
+}
+
+static void xmss_ltree(NVCONST uint8_t *leaf,
+                       NVCONST uint8_t *tmp_wotspk,
+                       const shash_prf_t *prf,
+                       uint16_t index) {
     uint8_t mem_wotspk[BUF_MAX_IDX * WOTS_N];
     memcpy(mem_wotspk, tmp_wotspk, BUF_MAX_IDX * WOTS_N);
 
@@ -23,20 +37,28 @@ void xmss_ltree_gen(NVCONST uint8_t *leaf,
     while (l > 1) {
         const uint8_t bound = l >> 1u;
 
+#ifdef LEDGER_SPECIFIC
         for (uint8_t i = 0; i < bound; i++) {
-            hashh_t hashh_in;
-            memset(hashh_in.basic.raw, 0, 96);
-            memcpy(hashh_in.basic.key, pub_seed, 32);
-
-            hashh_in.basic.adrs.type = HtoNL(SHASH_TYPE_H);
-            hashh_in.basic.adrs.trees.ltree = HtoNL(index);
-            hashh_in.basic.adrs.trees.height = HtoNL(tree_height);
-            hashh_in.basic.adrs.trees.index = HtoNL(i);
+            union ADRS_t adrs;
+            xmss_node_adrs(&adrs, SHASH_TYPE_H, index, tree_height, i);
 
             uint8_t *src = get_p(tmp_wotspk, mem_wotspk, i * 2u);
             uint8_t *dst = get_p(tmp_wotspk, mem_wotspk, i);
-            shash_h(dst, src, &hashh_in);
+            shash_h(dst, src, prf, &adrs);
         }
+#else
+        // All nodes of a level are independent and go out as one batch
+        union ADRS_t adrs[WOTS_LEN / 2];
+        const uint8_t *src[WOTS_LEN / 2];
+        uint8_t *dst[WOTS_LEN / 2];
+
+        for (uint8_t i = 0; i < bound; i++) {
+            xmss_node_adrs(&adrs[i], SHASH_TYPE_H, index, tree_height, i);
+            src[i] = get_p(tmp_wotspk, mem_wotspk, i * 2u);
+            dst[i] = get_p(tmp_wotspk, mem_wotspk, i);
+        }
+        shash_h_xN(dst, src, prf, adrs, bound);
+#endif
 
         if (l & 1u) {
             uint8_t *src = get_p(tmp_wotspk, mem_wotspk, (l - 1u));
@@ -54,12 +76,123 @@ void xmss_ltree_gen(NVCONST uint8_t *leaf,
     nvcpy(leaf, mem_wotspk, WOTS_N);
 }
 
+// Streaming L-tree: public key elements are merged as they are produced
+// Two nodes of the same height are hashed together right away. The odd node of a level
+// is carried up unchanged, which only happens to the last node, so at the end the stack
+// is folded from the top, lifting each node to the height of the one below it
+
+// Merges the top two entries into the lower one
+static void xmss_ltree_merge(xmss_ltree_stack_t *st, const shash_prf_t *pub_prf, uint16_t index) {
+    // stack entries are contiguous, so both children are already in place
+    const uint8_t t = st->top - 2;
+    union ADRS_t adrs;
+    xmss_node_adrs(&adrs, SHASH_TYPE_H, index, st->height[t], st->node_index[t] >> 1u);
+    shash_h(st->stack[t], st->stack[t], pub_prf, &adrs);
+    st->height[t]++;
+    st->node_index[t] >>= 1u;
+    st->top--;
+}
+
+// Computes chain `chain` onto the stack and merges it, returns the hash cost
+static uint16_t xmss_ltree_push(xmss_ltree_stack_t *st,
+                                const shash_prf_t *seed_prf,
+                                const shash_prf_t *pub_prf,
+                                uint16_t index,
+                                uint8_t chain) {
+    uint16_t cost = XMSS_COST_CHAIN;
+    wotsp_gen_pk_chain(st->stack[st->top], seed_prf, pub_prf, index, chain);
+    st->height[st->top] = 0;
+    st->node_index[st->top] = chain;
+    st->top++;
+
+    while (st->top > 1 && st->height[st->top - 1] == st->height[st->top - 2]) {
+        xmss_ltree_merge(st, pub_prf, index);
+        cost += XMSS_COST_NODE;
+    }
+    return cost;
+}
+
+// Folds the stack into stack[0] once all chains are in
+static uint16_t xmss_ltree_fold(xmss_ltree_stack_t *st, const shash_prf_t *pub_prf, uint16_t index) {
+    uint16_t cost = 0;
+    while (st->top > 1) {
+        // lift the last node to the level of its left neighbour
+        st->node_index[st->top - 1] >>= (st->height[st->top - 2] - st->height[st->top - 1]);
+        xmss_ltree_merge(st, pub_prf, index);
+        cost += XMSS_COST_NODE;
+    }
+    return cost;
+}
+
+void xmss_ltree_stream(uint8_t *leaf, const uint8_t *seed, const uint8_t *pub_seed, uint16_t index) {
+    xmss_ltree_stack_t st;
+    st.top = 0;
+
+    shash_prf_t pub_prf;
+    shash_prf_t seed_prf;
+    shash_prf_init(&pub_prf, pub_seed);
+    shash_prf_init(&seed_prf, seed);
+
+    for (uint8_t c = 0; c < WOTS_LEN; c++) {
+        xmss_ltree_push(&st, &seed_prf, &pub_prf, index, c);
+    }
+    xmss_ltree_fold(&st, &pub_prf, index);
+
+    memcpy(leaf, st.stack[0], WOTS_N);
+}
+
+void xmss_ltree_gen(NVCONST uint8_t *leaf,
+                    NVCONST uint8_t *tmp_wotspk,
+                    const uint8_t *pub_seed,
+                    uint16_t index) {
+    shash_prf_t prf;
+    shash_prf_init(&prf, pub_seed);
+    xmss_ltree(leaf, tmp_wotspk, &prf, index);
+}
+
+#ifndef LEDGER_SPECIFIC
+// Computes the tree one full level at a time so every level is a single batch
+static void xmss_treehash_levels(uint8_t *root_out,
+                                 uint8_t *authpath,
+                                 const uint8_t *nodes,
+                                 const shash_prf_t *prf,
+                                 const uint16_t leaf_index) {
+    uint8_t level[(XMSS_NUM_NODES / 2) * WOTS_N];
+    union ADRS_t adrs[XMSS_NUM_NODES / 2];
+    const uint8_t *src[XMSS_NUM_NODES / 2];
+    uint8_t *dst[XMSS_NUM_NODES / 2];
+
+    const uint8_t *prev = nodes;
+    uint16_t count = XMSS_NUM_NODES;
+
+    for (uint8_t h = 0; h < XMSS_H; h++) {
+        memcpy(authpath + h * WOTS_N, prev + ((leaf_index >> h) ^ 0x1u) * WOTS_N, WOTS_N);
+
+        count >>= 1u;
+        for (uint16_t i = 0; i < count; i++) {
+            xmss_node_adrs(&adrs[i], SHASH_TYPE_HASH, 0, h, i);
+            src[i] = prev + 2 * i * WOTS_N;
+            dst[i] = level + i * WOTS_N;
+        }
+        shash_h_xN(dst, src, prf, adrs, count);
+        prev = level;
+    }
+
+    memcpy(root_out, level, WOTS_N);
+}
+#endif
+
 void xmss_treehash(uint8_t *root_out,
                    uint8_t *authpath,
                    const uint8_t *nodes,
                    const uint8_t *pub_seed,
                    const uint16_t leaf_index) {
-    hashh_t h_in;
+    shash_prf_t prf;
+    shash_prf_init(&prf, pub_seed);
+
+#ifndef LEDGER_SPECIFIC
+    xmss_treehash_levels(root_out, authpath, nodes, &prf, leaf_index);
+#else
     uint8_t stack[XMSS_STK_SIZE];
     uint16_t stack_levels[XMSS_STK_LEVELS];
     uint32_t stack_offset = 0;
@@ -76,17 +209,13 @@ void xmss_treehash(uint8_t *root_out,
 
         while (stack_offset > 1 && stack_levels[stack_offset - 1] == stack_levels[stack_offset - 2]) {
             uint16_t tree_idx = (idx >> (stack_levels[stack_offset - 1u] + 1u));
-            memset(h_in.raw, 0, 96);
-
-            h_in.basic.adrs.type = HtoNL(SHASH_TYPE_HASH);
-            h_in.basic.adrs.trees.height = HtoNL(stack_levels[stack_offset - 1u]);
-            h_in.basic.adrs.trees.index = HtoNL(tree_idx);
 
-            memcpy(h_in.basic.key, pub_seed, WOTS_N);
+            union ADRS_t adrs;
+            xmss_node_adrs(&adrs, SHASH_TYPE_HASH, 0, stack_levels[stack_offset - 1u], tree_idx);
 
             unsigned char *in_out = stack + (stack_offset - 2) * WOTS_N;
 
-            shash_h(in_out, in_out, &h_in);
+            shash_h(in_out, in_out, &prf, &adrs);
 
             stack_levels[stack_offset - 2]++;
             stack_offset--;
@@ -98,6 +227,70 @@ void xmss_treehash(uint8_t *root_out,
     }
 
     memcpy(root_out, stack, WOTS_N);
+#endif
+}
+
+void xmss_tree_cache_build(NVCONST xmss_tree_cache_t *tree,
+                           uint8_t *root_out,
+                           const uint8_t *nodes,
+                           const uint8_t *pub_seed) {
+    shash_prf_t prf;
+    shash_prf_init(&prf, pub_seed);
+
+    const uint8_t ready = 0;
+    nvcpy(&tree->ready, &ready, 1);
+
+    const uint8_t *prev = nodes;
+    uint16_t count = XMSS_NUM_NODES;
+
+    for (uint8_t h = 1; h <= XMSS_H; h++) {
+        count >>= 1u;
+        NVCONST uint8_t *level = tree->nodes[xmss_tree_cache_slot(h, 0)];
+
+#ifdef LEDGER_SPECIFIC
+        for (uint16_t i = 0; i < count; i++) {
+            union ADRS_t adrs;
+            uint8_t node[WOTS_N];
+            xmss_node_adrs(&adrs, SHASH_TYPE_HASH, 0, h - 1, i);
+            shash_h(node, prev + 2 * i * WOTS_N, &prf, &adrs);
+            nvcpy(level + i * WOTS_N, node, WOTS_N);
+        }
+#else
+        union ADRS_t adrs[XMSS_NUM_NODES / 2];
+        const uint8_t *src[XMSS_NUM_NODES / 2];
+        uint8_t *dst[XMSS_NUM_NODES / 2];
+
+        for (uint16_t i = 0; i < count; i++) {
+            xmss_node_adrs(&adrs[i], SHASH_TYPE_HASH, 0, h - 1, i);
+            src[i] = prev + 2 * i * WOTS_N;
+            dst[i] = level + i * WOTS_N;
+        }
+        shash_h_xN(dst, src, &prf, adrs, count);
+#endif
+        prev = level;
+    }
+
+    memcpy(root_out, prev, WOTS_N);
+
+    const uint8_t done = XMSS_TREE_CACHE_READY;
+    nvcpy(&tree->ready, &done, 1);
+}
+
+void xmss_authpath(uint8_t *authpath,
+                   const uint8_t *nodes,
+                   NVCONST xmss_tree_cache_t *tree,
+                   const uint8_t *pub_seed,
+                   const uint16_t index) {
+    if (tree != NULL && tree->ready == XMSS_TREE_CACHE_READY) {
+        memcpy(authpath, nodes + (index ^ 1u) * WOTS_N, WOTS_N);
+        for (uint8_t h = 1; h < XMSS_H; h++) {
+            memcpy(authpath + h * WOTS_N, tree->nodes[xmss_tree_cache_slot(h, (index >> h) ^ 1u)], WOTS_N);
+        }
+        return;
+    }
+
+    uint8_t dummy_root[32];
+    xmss_treehash(dummy_root, authpath, nodes, pub_seed, index);
 }
 
 void xmss_randombits(NVCONST uint8_t *random_bits, const uint8_t sk_seed[48]) {
@@ -108,7 +301,7 @@ void xmss_randombits(NVCONST uint8_t *random_bits, const uint8_t sk_seed[48]) {
         cx_hash(&hash_sha3.header, CX_LAST, sk_seed, 48, buffer, 3*WOTS_N);
         nvcpy(random_bits, buffer, 3*WOTS_N);
 #else
-    shake256(random_bits, 3 * WOTS_N, sk_seed, 48);
+    hash_backend()->shake256(random_bits, 3 * WOTS_N, sk_seed, 48);
 #endif
 }
 
@@ -132,8 +325,18 @@ void xmss_gen_keys_2_get_nodes(NVCONST uint8_t *wots_buffer,
                                uint16_t idx) {
     uint8_t seed[WOTS_N];
     xmss_get_seed_i(seed, sk, idx);
+
+#ifdef LEDGER_SPECIFIC
+    // The public key never touches flash, wots_buffer is kept for callers
+    (void) wots_buffer;
+    uint8_t leaf[WOTS_N];
+    xmss_ltree_stream(leaf, seed, sk->pub_seed, idx);
+    nvcpy(xmss_node, leaf, WOTS_N);
+#else
+    // Batched chains and levels are faster on the host than streaming
     wotsp_gen_pk(wots_buffer, seed, sk->pub_seed, idx);
     xmss_ltree_gen(xmss_node, wots_buffer, sk->pub_seed, idx);
+#endif
 }
 
 void xmss_gen_keys_3_get_root(const uint8_t *xmss_nodes,
@@ -144,6 +347,141 @@ void xmss_gen_keys_3_get_root(const uint8_t *xmss_nodes,
     nvcpy(sk->root, root, WOTS_N);
 }
 
+void xmss_gen_keys_3_build_tree(const uint8_t *xmss_nodes,
+                                NVCONST xmss_tree_cache_t *tree,
+                                NVCONST xmss_sk_t *sk) {
+    uint8_t root[WOTS_N];
+    xmss_tree_cache_build(tree, root, xmss_nodes, sk->pub_seed);
+    nvcpy(sk->root, root, WOTS_N);
+}
+
+// Keygen treehash stack, one entry per full subtree not merged yet
+
+// Rebuilds the stack after `leaves` leaves from the stored leaves and tree cache
+static void xmss_tree_stack_resume(NVCONST xmss_tree_stack_t *stack,
+                                   NVCONST xmss_tree_cache_t *tree,
+                                   const uint8_t *nodes,
+                                   uint16_t leaves) {
+    // one entry per set bit of `leaves`, the last node of each full subtree
+    uint8_t offset = 0;
+    for (int8_t h = XMSS_H; h >= 0; h--) {
+        if (((leaves >> h) & 1u) == 0) {
+            continue;
+        }
+        const uint16_t node_index = (uint16_t) ((leaves >> h) - 1u);
+        const uint8_t *src = h == 0 ? nodes + node_index * WOTS_N
+                                    : tree->nodes[xmss_tree_cache_slot((uint8_t) h, node_index)];
+        const uint8_t level = (uint8_t) h;
+        nvcpy(stack->nodes[offset], src, WOTS_N);
+        nvcpy(&stack->levels[offset], &level, 1);
+        offset++;
+    }
+    nvcpy(&stack->offset, &offset, 1);
+}
+
+// Folds leaf `idx` into the stack, merged nodes are written to `tree`. Returns the number of merges
+static uint8_t xmss_tree_stack_push(NVCONST xmss_tree_stack_t *stack,
+                                    NVCONST xmss_tree_cache_t *tree,
+                                    const uint8_t *leaf,
+                                    const shash_prf_t *prf,
+                                    uint16_t idx) {
+    uint8_t offset = stack->offset;
+    uint8_t merges = 0;
+
+    const uint8_t leaf_level = 0;
+    nvcpy(stack->nodes[offset], leaf, WOTS_N);
+    nvcpy(&stack->levels[offset], &leaf_level, 1);
+    offset++;
+
+    while (offset > 1 && stack->levels[offset - 1] == stack->levels[offset - 2]) {
+        const uint8_t height = stack->levels[offset - 1];
+        const uint16_t parent = idx >> (height + 1u);
+
+        union ADRS_t adrs;
+        uint8_t node[WOTS_N];
+        xmss_node_adrs(&adrs, SHASH_TYPE_HASH, 0, height, parent);
+        shash_h(node, stack->nodes[offset - 2], prf, &adrs);
+
+        const uint8_t level = height + 1;
+        nvcpy(stack->nodes[offset - 2], node, WOTS_N);
+        nvcpy(&stack->levels[offset - 2], &level, 1);
+        nvcpy(tree->nodes[xmss_tree_cache_slot(level, parent)], node, WOTS_N);
+        offset--;
+        merges++;
+    }
+
+    nvcpy(&stack->offset, &offset, 1);
+    return merges;
+}
+
+void xmss_keygen_init(xmss_keygen_ctx_t *ctx,
+                      NVCONST uint8_t *xmss_nodes,
+                      NVCONST xmss_tree_cache_t *tree,
+                      NVCONST xmss_tree_stack_t *stack,
+                      const uint16_t leaf) {
+    memset(ctx, 0, sizeof(xmss_keygen_ctx_t));
+    ctx->active = 1;
+    ctx->leaf = leaf;
+    ctx->xmss_nodes = (uint8_t *) xmss_nodes;
+    ctx->tree = tree;
+    ctx->stack = stack;
+
+    if (leaf == 0) {
+        const uint8_t zero = 0;
+        nvcpy(&tree->ready, &zero, 1);
+        nvcpy(&stack->offset, &zero, 1);
+    } else {
+        xmss_tree_stack_resume(stack, tree, xmss_nodes, leaf);
+    }
+}
+
+uint16_t xmss_keygen_step(xmss_keygen_ctx_t *ctx,
+                          NVCONST xmss_sk_t *sk,
+                          const uint16_t budget) {
+    uint16_t cost = 0;
+
+    shash_prf_t pub_prf;
+    shash_prf_t seed_prf;
+    shash_prf_init(&pub_prf, sk->pub_seed);
+    if (ctx->chain != 0) {
+        shash_prf_init(&seed_prf, ctx->seed_i);
+    }
+
+    while (cost < budget && ctx->leaf < XMSS_NUM_NODES) {
+        if (ctx->chain == 0) {
+            xmss_get_seed_i(ctx->seed_i, sk, ctx->leaf);
+            shash_prf_init(&seed_prf, ctx->seed_i);
+            ctx->ltree.top = 0;
+            cost += XMSS_COST_PRF;
+        }
+
+        cost += xmss_ltree_push(&ctx->ltree, &seed_prf, &pub_prf, ctx->leaf, ctx->chain);
+        ctx->chain++;
+        if (ctx->chain < WOTS_LEN) {
+            continue;
+        }
+
+        // the leaf is stored and folded into the tree right away
+        const uint8_t *leaf = ctx->ltree.stack[0];
+        cost += xmss_ltree_fold(&ctx->ltree, &pub_prf, ctx->leaf);
+        nvcpy(ctx->xmss_nodes + ctx->leaf * WOTS_N, leaf, WOTS_N);
+        cost += XMSS_COST_NODE * xmss_tree_stack_push(ctx->stack, ctx->tree, leaf, &pub_prf, ctx->leaf);
+        ctx->leaf++;
+        ctx->chain = 0;
+    }
+
+    if (ctx->leaf == XMSS_NUM_NODES && ctx->active) {
+        // the root is the last node left on the stack
+        nvcpy(sk->root, ctx->stack->nodes[0], WOTS_N);
+
+        const uint8_t done = XMSS_TREE_CACHE_READY;
+        nvcpy(&ctx->tree->ready, &done, 1);
+        ctx->active = 0;
+    }
+
+    return cost;
+}
+
 void xmss_gen_keys(xmss_sk_t *sk,
                    const uint8_t *sk_seed) {
     xmss_gen_keys_1_get_seeds(sk, sk_seed);
@@ -161,32 +499,50 @@ void xmss_gen_keys(xmss_sk_t *sk,
     xmss_gen_keys_3_get_root(xmss_nodes, sk);
 }
 
-void xmss_digest(xmss_digest_t *digest,
-                 const uint8_t msg[32],
-                 const xmss_sk_t *sk,
-                 const uint16_t index) {
-    // get randomness
+__INLINE void xmss_digest_input(hashh_t *h_in,
+                                const uint8_t *R,
+                                const uint8_t *root,
+                                const uint16_t index,
+                                const uint8_t msg[32]) {
+    memset(h_in->raw, 0, 160);
+    h_in->digest.type[31] = SHASH_TYPE_HASH;
+    memcpy(h_in->digest.R, R, WOTS_N);
+    memcpy(h_in->digest.root, root, 32);
+    h_in->digest.index = NtoHL(index);
+    memcpy(h_in->digest.msg_hash, msg, 32);
+}
+
+void xmss_digest_randomness(uint8_t *R, const xmss_sk_t *sk, const uint16_t index) {
     shash_input_t prf_in;
     PRF_init(&prf_in, SHASH_TYPE_PRF);
     memcpy(prf_in.key, sk->prf_seed, WOTS_N);
     prf_in.R.index = HtoNL(index);
-    shash96(digest->randomness, &prf_in);
+    shash96(R, &prf_in);
+}
 
-    // Digest hash
+// Message hash once digest->randomness is set
+static void xmss_digest_hash(xmss_digest_t *digest,
+                             const uint8_t msg[32],
+                             const xmss_sk_t *sk,
+                             const uint16_t index) {
     hashh_t h_in;
-    memset(h_in.raw, 0, 160);
-    h_in.digest.type[31] = SHASH_TYPE_HASH;
-    memcpy(h_in.digest.R, digest->randomness, WOTS_N);
-    memcpy(h_in.digest.root, sk->root, 32);
-    h_in.digest.index = NtoHL(index);
-    memcpy(h_in.digest.msg_hash, msg, 32);
+    xmss_digest_input(&h_in, digest->randomness, sk->root, index, msg);
     shash160(digest->hash, &h_in);
 }
 
+void xmss_digest(xmss_digest_t *digest,
+                 const uint8_t msg[32],
+                 const xmss_sk_t *sk,
+                 const uint16_t index) {
+    xmss_digest_randomness(digest->randomness, sk, index);
+    xmss_digest_hash(digest, msg, sk, index);
+}
+
 void xmss_sign(xmss_signature_t *sig,
                const uint8_t msg[32],
                const xmss_sk_t *sk,
                const uint8_t xmss_nodes[XMSS_NODES_BUFSIZE],
+               NVCONST xmss_tree_cache_t *tree,
                const uint16_t index) {
     // Get message digest
     xmss_digest_t msg_digest;
@@ -196,14 +552,7 @@ void xmss_sign(xmss_signature_t *sig,
     sig->index = NtoHL(index);
     memcpy(sig->randomness, msg_digest.randomness, 32);
 
-    // The following is a trick to reuse and save RAM
-    uint8_t dummy_root[32];
-    xmss_treehash(
-            dummy_root,
-            sig->auth_path,
-            xmss_nodes,
-            sk->pub_seed,
-            index);
+    xmss_authpath(sig->auth_path, xmss_nodes, tree, sk->pub_seed, index);
 
     // The following is a trick to reuse and save RAM
     uint8_t seed_i[32];
@@ -216,15 +565,50 @@ void xmss_sign(xmss_signature_t *sig,
                index);
 }
 
+void xmss_precomp_invalidate(xmss_precomp_t *pc) {
+    pc->ready = 0;
+}
+
+bool xmss_precomp_ready(const xmss_precomp_t *pc, const uint16_t index) {
+    return pc->ready == XMSS_PRECOMP_READY && pc->index == index;
+}
+
+void xmss_precomp_fill(xmss_precomp_t *pc,
+                       const xmss_sk_t *sk,
+                       const uint16_t index) {
+    if (xmss_precomp_ready(pc, index)) {
+        return;
+    }
+
+    xmss_get_seed_i(pc->seed_i, sk, index);
+    xmss_digest_randomness(pc->randomness, sk, index);
+    pc->index = index;
+    pc->ready = XMSS_PRECOMP_READY;
+}
+
 void xmss_sign_incremental_init(xmss_sig_ctx_t *ctx,
                                 const uint8_t msg[32],
                                 const xmss_sk_t *sk,
                                 uint8_t xmss_nodes[XMSS_NODES_BUFSIZE],
+                                NVCONST xmss_tree_cache_t *tree,
+                                const xmss_precomp_t *precomp,
                                 const uint16_t index) {
     ctx->sig_chunk_idx = 0;
     ctx->written = 0;
-    xmss_digest(&ctx->msg_digest, msg, sk, index);
     ctx->xmss_nodes = xmss_nodes;
+    ctx->tree = tree;
+    ctx->authpath = NULL;
+
+    if (precomp != NULL && xmss_precomp_ready(precomp, index)) {
+        // Only the message hash and the chains are left
+        memcpy(ctx->msg_digest.randomness, precomp->randomness, WOTS_N);
+        xmss_digest_hash(&ctx->msg_digest, msg, sk, index);
+
+        wotsp_sign_init_ctx(&ctx->wots_ctx, sk->pub_seed, precomp->seed_i, index);
+        return;
+    }
+
+    xmss_digest(&ctx->msg_digest, msg, sk, index);
 
     uint8_t seed_i[32];
     xmss_get_seed_i(seed_i, sk, index);
@@ -288,14 +672,519 @@ bool xmss_sign_incremental_last(xmss_sig_ctx_t *ctx,
     }
 
     // Last block is the authpath
-    uint8_t dummy_root[32];
-    xmss_treehash(
-            dummy_root,
-            out,
-            ctx->xmss_nodes,
-            sk->pub_seed,
-            index);
+    if (ctx->authpath != NULL) {
+        memcpy(out, ctx->authpath, XMSS_H * XMSS_N);
+    } else {
+        xmss_authpath(out, ctx->xmss_nodes, ctx->tree, sk->pub_seed, index);
+    }
     ctx->written += XMSS_H * XMSS_N;
     ctx->sig_chunk_idx++;
     return true;
 }
+
+// Auth nodes above this height are built from pieces of this height, one piece per step
+#define XMSS_SIGN_PIECE_H       5u
+
+// Node `node_index` at `height` (up to XMSS_SIGN_PIECE_H) from its leaves, one leaf at a time
+static void xmss_subtree_node(uint8_t *out,
+                              const uint8_t *nodes,
+                              const shash_prf_t *prf,
+                              const uint8_t height,
+                              const uint16_t node_index) {
+    uint8_t stack[XMSS_SIGN_PIECE_H + 1][WOTS_N];
+    uint8_t stack_levels[XMSS_SIGN_PIECE_H + 1];
+    uint8_t stack_offset = 0;
+
+    const uint16_t first = (uint16_t) (node_index << height);
+    for (uint16_t idx = first; idx < first + (1u << height); idx++) {
+        memcpy(stack[stack_offset], nodes + idx * WOTS_N, WOTS_N);
+        stack_levels[stack_offset++] = 0;
+
+        while (stack_offset > 1 && stack_levels[stack_offset - 1] == stack_levels[stack_offset - 2]) {
+            const uint8_t h = stack_levels[stack_offset - 1];
+            union ADRS_t adrs;
+            xmss_node_adrs(&adrs, SHASH_TYPE_HASH, 0, h, (uint16_t) (idx >> (h + 1u)));
+            shash_h(stack[stack_offset - 2], stack[stack_offset - 2], prf, &adrs);
+            stack_levels[stack_offset - 2]++;
+            stack_offset--;
+        }
+    }
+
+    memcpy(out, stack[0], WOTS_N);
+}
+
+// Next piece of the pending auth path level. Levels go top-down so the slots of the lower
+// levels, not computed yet, hold the partial nodes of the level being built
+static void xmss_sign_nv_auth_step(xmss_sig_ctx_t *ctx, NVCONST xmss_signature_t *sig) {
+    const uint8_t h = (uint8_t) (XMSS_H - 1u - ctx->auth_levels);
+    const uint16_t index = (uint16_t) NtoHL(ctx->wots_ctx.adrs.otshash.OTS);
+    const uint16_t sibling = (uint16_t) ((index >> h) ^ 1u);
+
+    shash_prf_t prf;
+    shash_prf_init(&prf, ctx->pub_seed);
+
+    uint8_t node[WOTS_N];
+    if (h <= XMSS_SIGN_PIECE_H) {
+        xmss_subtree_node(node, ctx->xmss_nodes, &prf, h, sibling);
+        nvcpy(sig->auth_path + h * WOTS_N, node, WOTS_N);
+        ctx->auth_levels++;
+        return;
+    }
+
+    const uint8_t part = ctx->auth_part;
+    uint16_t node_index = (uint16_t) ((sibling << (h - XMSS_SIGN_PIECE_H)) + part);
+    xmss_subtree_node(node, ctx->xmss_nodes, &prf, XMSS_SIGN_PIECE_H, node_index);
+
+    // Treehash over the pieces, the stack is slots 0.. of the auth path
+    uint8_t depth = 0;
+    for (uint8_t p = part; p != 0; p &= (uint8_t) (p - 1u)) {
+        depth++;
+    }
+    for (uint8_t ht = XMSS_SIGN_PIECE_H, p = part; p & 1u; ht++, p >>= 1u, node_index >>= 1u) {
+        uint8_t in[2 * WOTS_N];
+        union ADRS_t adrs;
+        depth--;
+        memcpy(in, sig->auth_path + depth * WOTS_N, WOTS_N);
+        memcpy(in + WOTS_N, node, WOTS_N);
+        xmss_node_adrs(&adrs, SHASH_TYPE_HASH, 0, ht, (uint16_t) (node_index >> 1u));
+        shash_h(node, in, &prf, &adrs);
+    }
+
+    if (part + 1u == (1u << (h - XMSS_SIGN_PIECE_H))) {
+        nvcpy(sig->auth_path + h * WOTS_N, node, WOTS_N);
+        ctx->auth_levels++;
+        ctx->auth_part = 0;
+        return;
+    }
+
+    nvcpy(sig->auth_path + depth * WOTS_N, node, WOTS_N);
+    ctx->auth_part++;
+}
+
+// Hash cost of the work not done yet: remaining chains, then pending auth path levels
+static uint16_t xmss_sign_nv_cost_left(const xmss_sig_ctx_t *ctx) {
+    uint8_t digits[WOTS_LEN];
+    wotsp_basew_digits(digits, ctx->msg_digest.hash);
+
+    uint16_t cost = 0;
+    for (uint32_t c = NtoHL(ctx->wots_ctx.adrs.otshash.chain); c < WOTS_LEN; c++) {
+        cost += XMSS_COST_PRF + digits[c] * XMSS_COST_CHAIN_STEP;
+    }
+    for (uint8_t done = ctx->auth_levels; done < XMSS_H; done++) {
+        cost += ((1u << (XMSS_H - 1u - done)) - 1u) * XMSS_COST_NODE;
+    }
+    return cost - ctx->auth_part * (1u << XMSS_SIGN_PIECE_H) * XMSS_COST_NODE;
+}
+
+// Hash cost of the next xmss_sign_nv_step
+static uint16_t xmss_sign_nv_next_cost(const xmss_sig_ctx_t *ctx) {
+    const uint32_t chain = NtoHL(ctx->wots_ctx.adrs.otshash.chain);
+    if (chain < WOTS_LEN) {
+        uint8_t digits[WOTS_LEN];
+        wotsp_basew_digits(digits, ctx->msg_digest.hash);
+        return XMSS_COST_PRF + digits[chain] * XMSS_COST_CHAIN_STEP;
+    }
+    if (ctx->auth_levels < XMSS_H) {
+        const uint8_t h = (uint8_t) (XMSS_H - 1u - ctx->auth_levels);
+        return ((1u << (h < XMSS_SIGN_PIECE_H ? h : XMSS_SIGN_PIECE_H)) - 1u) * XMSS_COST_NODE;
+    }
+    return 0;
+}
+
+// WOTS+ chains computed in the background go to an NV signature one chain at a time
+void xmss_sign_nv_init(xmss_sig_ctx_t *ctx,
+                       NVCONST xmss_signature_t *sig,
+                       const uint8_t msg[32],
+                       const xmss_sk_t *sk,
+                       uint8_t xmss_nodes[XMSS_NODES_BUFSIZE],
+                       NVCONST xmss_tree_cache_t *tree,
+                       const xmss_precomp_t *precomp,
+                       const uint16_t index) {
+    xmss_sign_incremental_init(ctx, msg, sk, xmss_nodes, tree, precomp, index);
+    ctx->pub_seed = sk->pub_seed;
+    ctx->cost = 0;
+
+    // Without a cached tree the auth path is built level by level into sig, so no
+    // single chunk carries the whole tree
+    const bool cached = tree != NULL && tree->ready == XMSS_TREE_CACHE_READY;
+    ctx->auth_levels = XMSS_H;
+    ctx->auth_part = 0;
+    if (ctx->authpath == NULL && !cached) {
+        ctx->auth_levels = 0;
+        ctx->authpath = sig->auth_path;
+    }
+
+    uint8_t header[4 + XMSS_N];
+    const uint32_t signature_index = NtoHL(index);
+    memcpy(header, &signature_index, 4);
+    memcpy(header + 4, ctx->msg_digest.randomness, XMSS_N);
+    nvcpy(sig->raw, header, sizeof(header));
+}
+
+void xmss_sign_nv_use_authpath(xmss_sig_ctx_t *ctx, const uint8_t *authpath) {
+    ctx->authpath = authpath;
+    ctx->auth_levels = XMSS_H;
+}
+
+void xmss_sign_nv_replay(xmss_sig_ctx_t *ctx, NVCONST xmss_signature_t *sig) {
+    ctx->sig_chunk_idx = 0;
+    ctx->written = 0;
+    ctx->cost = 0;
+    ctx->wots_ctx.adrs.otshash.chain = HtoNL(WOTS_LEN);
+    xmss_sign_nv_use_authpath(ctx, sig->auth_path);
+}
+
+uint16_t xmss_sign_nv_step(xmss_sig_ctx_t *ctx, NVCONST xmss_signature_t *sig) {
+    const uint16_t before = xmss_sign_nv_cost_left(ctx);
+
+    if (!wotsp_sign_ready(&ctx->wots_ctx)) {
+        uint8_t tmp[WOTS_N];
+        const uint32_t chain = NtoHL(ctx->wots_ctx.adrs.otshash.chain);
+        wotsp_sign_step(&ctx->wots_ctx, tmp, ctx->msg_digest.hash);
+        nvcpy(sig->wots_sig + WOTS_N * chain, tmp, WOTS_N);
+    } else if (ctx->auth_levels < XMSS_H) {
+        xmss_sign_nv_auth_step(ctx, sig);
+    }
+
+    return before - xmss_sign_nv_cost_left(ctx);
+}
+
+bool xmss_sign_nv_done(const xmss_sig_ctx_t *ctx) {
+    return WOTS_LEN <= NtoHL(ctx->wots_ctx.adrs.otshash.chain) && ctx->auth_levels >= XMSS_H;
+}
+
+bool xmss_sign_nv_prepare(xmss_sig_ctx_t *ctx,
+                          NVCONST xmss_signature_t *sig,
+                          const uint16_t index,
+                          const uint16_t end) {
+    const uint16_t wots_begin = 4 + XMSS_N;
+    while (!wotsp_sign_ready(&ctx->wots_ctx) &&
+           wots_begin + WOTS_N * NtoHL(ctx->wots_ctx.adrs.otshash.chain) < end) {
+        xmss_sign_nv_step(ctx, sig);
+    }
+
+    if (end <= wots_begin + WOTS_SIGSIZE) {
+        return false;
+    }
+
+    while (!xmss_sign_nv_done(ctx)) {
+        xmss_sign_nv_step(ctx, sig);
+    }
+    if (ctx->authpath != sig->auth_path) {
+        uint8_t tmp[XMSS_AUTHPATHSIZE];
+        if (ctx->authpath != NULL) {
+            memcpy(tmp, ctx->authpath, XMSS_AUTHPATHSIZE);
+        } else {
+            xmss_authpath(tmp, ctx->xmss_nodes, ctx->tree, ctx->pub_seed, index);
+        }
+        nvcpy(sig->auth_path, tmp, XMSS_AUTHPATHSIZE);
+        ctx->authpath = sig->auth_path;
+    }
+    return true;
+}
+
+bool xmss_sign_nv_chunk(xmss_sig_ctx_t *ctx,
+                        uint8_t *out,
+                        NVCONST xmss_signature_t *sig,
+                        const xmss_sk_t *sk,
+                        const uint16_t index) {
+    ctx->written = 0;
+    ctx->cost = 0;
+
+    if (ctx->sig_chunk_idx > 10) {
+        return true;
+    }
+
+    // Output keeps the layout of xmss_sign_incremental. The work is scheduled apart from it:
+    // whatever this chunk has to output first, then more work ahead while the next step
+    // brings this chunk closer to its share of what is left
+    const uint8_t chunks_left = (uint8_t) (11u - ctx->sig_chunk_idx);
+    const uint16_t budget = (uint16_t) ((xmss_sign_nv_cost_left(ctx) + chunks_left - 1u) / chunks_left);
+
+    const uint8_t chains = ctx->sig_chunk_idx == 10 ? WOTS_LEN : (uint8_t) (4u + 7u * ctx->sig_chunk_idx);
+    while (NtoHL(ctx->wots_ctx.adrs.otshash.chain) < chains) {
+        ctx->cost += xmss_sign_nv_step(ctx, sig);
+    }
+    while (!xmss_sign_nv_done(ctx) &&
+           (ctx->cost + xmss_sign_nv_next_cost(ctx) / 2u < budget || ctx->sig_chunk_idx == 10)) {
+        ctx->cost += xmss_sign_nv_step(ctx, sig);
+    }
+
+    if (ctx->sig_chunk_idx == 10) {
+        const uint16_t cost = ctx->cost;
+        const bool last = xmss_sign_incremental_last(ctx, out, sk, index);
+        ctx->cost = cost;
+
+        // keep the whole signature in sig so chunks can be read again
+        if (ctx->authpath != sig->auth_path) {
+            nvcpy(sig->auth_path, out, XMSS_AUTHPATHSIZE);
+        }
+        return last;
+    }
+
+    const uint16_t begin = ctx->sig_chunk_idx == 0 ? 0 : (uint16_t) (4 + XMSS_N + WOTS_N * (chains - 7u));
+    const uint16_t end = (uint16_t) (4 + XMSS_N + WOTS_N * chains);
+    memcpy(out, sig->raw + begin, end - begin);
+    ctx->written = end - begin;
+    ctx->sig_chunk_idx++;
+    return false;
+}
+
+////////////////////////////
+// Verification
+
+// Leaf claimed by a signature: WOTS+ public key from the signature, compressed by the L-tree
+static void xmss_sig_leaf(uint8_t *leaf,
+                          const uint8_t *msg_hash,
+                          const shash_prf_t *prf,
+                          const xmss_signature_t *sig,
+                          const uint16_t index) {
+    uint8_t wots_pk[WOTS_LEN * WOTS_N];
+    wotsp_pk_from_sig(wots_pk, sig->wots_sig, msg_hash, prf, index);
+    xmss_ltree(leaf, wots_pk, prf, index);
+}
+
+// Orders a node and its authentication node as the input of their parent
+__INLINE void xmss_auth_input(uint8_t *in,
+                              union ADRS_t *adrs,
+                              const uint8_t *node,
+                              const uint8_t *auth,
+                              const uint16_t index,
+                              const uint8_t height) {
+    const uint16_t node_index = index >> height;
+    const bool right = (node_index & 1u) != 0;
+    memcpy(in, right ? auth : node, WOTS_N);
+    memcpy(in + WOTS_N, right ? node : auth, WOTS_N);
+    xmss_node_adrs(adrs, SHASH_TYPE_HASH, 0, height, node_index >> 1u);
+}
+
+uint16_t xmss_authpath_delta(uint8_t *out,
+                             const uint8_t *authpath,
+                             const uint16_t index,
+                             const uint16_t cached_index) {
+    // the auth node of level h is the sibling of index >> h, the top level differs for any
+    // two indices in different halves and then every level does
+    if ((index >> (XMSS_H - 1u)) != (cached_index >> (XMSS_H - 1u))) {
+        memcpy(out, authpath, XMSS_AUTHPATHSIZE);
+        return XMSS_AUTHPATHSIZE;
+    }
+
+    uint16_t written = 1;
+    out[0] = 0;
+    for (uint8_t h = 0; h < XMSS_H; h++) {
+        if ((index >> h) != (cached_index >> h)) {
+            out[0] |= (uint8_t) (1u << h);
+            memcpy(out + written, authpath + h * WOTS_N, WOTS_N);
+            written += WOTS_N;
+        }
+    }
+    return written;
+}
+
+bool xmss_verify(const xmss_pk_t *pk,
+                 const uint8_t msg[32],
+                 const xmss_signature_t *sig) {
+    const uint32_t index = NtoHL(sig->index);
+    if (index >= XMSS_NUM_NODES) {
+        return false;
+    }
+
+    hashh_t h_in;
+    uint8_t msg_hash[WOTS_N];
+    xmss_digest_input(&h_in, sig->randomness, pk->root, (uint16_t) index, msg);
+    shash160(msg_hash, &h_in);
+
+    shash_prf_t prf;
+    shash_prf_init(&prf, pk->pub_seed);
+
+    uint8_t node[WOTS_N];
+    xmss_sig_leaf(node, msg_hash, &prf, sig, (uint16_t) index);
+
+    for (uint8_t h = 0; h < XMSS_H; h++) {
+        uint8_t in[2 * WOTS_N];
+        union ADRS_t adrs;
+        xmss_auth_input(in, &adrs, node, sig->auth_path + h * WOTS_N, (uint16_t) index, h);
+        shash_h(node, in, &prf, &adrs);
+    }
+
+    return memcmp(node, pk->root, WOTS_N) == 0;
+}
+
+#ifndef LEDGER_SPECIFIC
+#include <stdlib.h>
+
+// Tree nodes already authenticated by a verified signature, all levels of one key
+// Level h starts at slot 2^(H+1) - 2^(H+1-h)
+typedef struct {
+    uint8_t node[2 * XMSS_NUM_NODES - 1][WOTS_N];
+    bool known[2 * XMSS_NUM_NODES - 1];
+} xmss_verify_memo_t;
+
+__INLINE uint16_t xmss_memo_slot(uint8_t height, uint16_t node_index) {
+    return (uint16_t) (2 * XMSS_NUM_NODES - ((2 * XMSS_NUM_NODES) >> height) + node_index);
+}
+
+__INLINE void xmss_memo_put(xmss_verify_memo_t *memo, uint8_t height, uint16_t node_index, const uint8_t *node) {
+    const uint16_t slot = xmss_memo_slot(height, node_index);
+    memcpy(memo->node[slot], node, WOTS_N);
+    memo->known[slot] = true;
+}
+
+// The remaining authentication nodes must be the authenticated ones as well, otherwise
+// a signature with garbage above the join point would pass. Siblings of every known
+// node up to the root are known: they were stored by the signature that added it
+static bool xmss_memo_auth_match(const xmss_verify_memo_t *memo,
+                                 const xmss_signature_t *sig,
+                                 const uint16_t index,
+                                 const uint8_t height) {
+    for (uint8_t h = height; h < XMSS_H; h++) {
+        const uint16_t slot = xmss_memo_slot(h, (index >> h) ^ 1u);
+        if (!memo->known[slot] || memcmp(memo->node[slot], sig->auth_path + h * WOTS_N, WOTS_N) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Verifies up to XMSS_VERIFY_GROUP signatures of the same key, every step as one batch
+// A path stops as soon as it reaches a node that is already authenticated
+static void xmss_verify_group(bool results[],
+                              xmss_verify_memo_t *memo,
+                              const shash_prf_t *prf,
+                              const xmss_pk_t *pk,
+                              const uint8_t *msg[],
+                              const xmss_signature_t *sig[],
+                              const uint16_t member[],
+                              uint8_t count) {
+    uint16_t index[XMSS_VERIFY_GROUP];
+    uint16_t sig_of[XMSS_VERIFY_GROUP];
+    uint8_t path[XMSS_VERIFY_GROUP][XMSS_H][WOTS_N];
+    uint8_t node[XMSS_VERIFY_GROUP][WOTS_N];
+    uint8_t stop[XMSS_VERIFY_GROUP];
+    hashh_t h_in[XMSS_VERIFY_GROUP];
+    const hashh_t *h_p[XMSS_VERIFY_GROUP];
+    uint8_t *out_p[XMSS_VERIFY_GROUP];
+
+    // Message digests
+    uint8_t n = 0;
+    for (uint8_t k = 0; k < count; k++) {
+        const uint16_t m = member[k];
+        const uint32_t idx = NtoHL(sig[m]->index);
+        results[m] = false;
+        if (idx >= XMSS_NUM_NODES) {
+            continue;
+        }
+        index[n] = (uint16_t) idx;
+        sig_of[n] = m;
+        xmss_digest_input(&h_in[n], sig[m]->randomness, pk->root, index[n], msg[m]);
+        h_p[n] = &h_in[n];
+        out_p[n] = node[n];
+        n++;
+    }
+    shash160_xN(out_p, h_p, n);
+
+    for (uint8_t k = 0; k < n; k++) {
+        uint8_t msg_hash[WOTS_N];
+        memcpy(msg_hash, node[k], WOTS_N);
+        xmss_sig_leaf(node[k], msg_hash, prf, sig[sig_of[k]], index[k]);
+        stop[k] = XMSS_H + 1;
+    }
+
+    // Walk all paths up one level at a time
+    for (uint8_t h = 0; h <= XMSS_H; h++) {
+        uint8_t in[XMSS_VERIFY_GROUP][2 * WOTS_N];
+        union ADRS_t adrs[XMSS_VERIFY_GROUP];
+        const uint8_t *in_p[XMSS_VERIFY_GROUP];
+        uint8_t active = 0;
+
+        for (uint8_t k = 0; k < n; k++) {
+            if (stop[k] <= XMSS_H) {
+                continue;
+            }
+            const uint16_t slot = xmss_memo_slot(h, index[k] >> h);
+            if (memo->known[slot]) {
+                stop[k] = h;
+                results[sig_of[k]] = memcmp(memo->node[slot], node[k], WOTS_N) == 0 &&
+                                     xmss_memo_auth_match(memo, sig[sig_of[k]], index[k], h);
+                continue;
+            }
+            // the root is always known, so h < XMSS_H here
+            memcpy(path[k][h], node[k], WOTS_N);
+            xmss_auth_input(in[active], &adrs[active], node[k],
+                            sig[sig_of[k]]->auth_path + h * WOTS_N, index[k], h);
+            in_p[active] = in[active];
+            out_p[active] = node[k];
+            active++;
+        }
+        if (active == 0) {
+            break;
+        }
+        shash_h_xN(out_p, in_p, prf, adrs, active);
+    }
+
+    // Nodes under the point where a valid path joined the tree are authentic now
+    for (uint8_t k = 0; k < n; k++) {
+        const xmss_signature_t *s = sig[sig_of[k]];
+        if (!results[sig_of[k]]) {
+            continue;
+        }
+        for (uint8_t h = 0; h < stop[k]; h++) {
+            xmss_memo_put(memo, h, index[k] >> h, path[k][h]);
+            xmss_memo_put(memo, h, (index[k] >> h) ^ 1u, s->auth_path + h * WOTS_N);
+        }
+    }
+}
+
+uint16_t xmss_verify_batch(bool results[],
+                           const xmss_pk_t *pk[],
+                           const uint8_t *msg[],
+                           const xmss_signature_t *sig[],
+                           uint16_t n) {
+    xmss_verify_memo_t *memo = malloc(sizeof(xmss_verify_memo_t));
+    bool *done = calloc(n, sizeof(bool));
+    if (memo == NULL || done == NULL) {
+        free(memo);
+        free(done);
+        for (uint16_t i = 0; i < n; i++) {
+            results[i] = xmss_verify(pk[i], msg[i], sig[i]);
+        }
+    } else {
+        for (uint16_t i = 0; i < n; i++) {
+            if (done[i]) {
+                continue;
+            }
+
+            // One PRF midstate and one node memo per key
+            shash_prf_t prf;
+            shash_prf_init(&prf, pk[i]->pub_seed);
+            memset(memo->known, 0, sizeof(memo->known));
+            xmss_memo_put(memo, XMSS_H, 0, pk[i]->root);
+
+            uint16_t member[XMSS_VERIFY_GROUP];
+            uint8_t count = 0;
+            for (uint16_t j = i; j < n; j++) {
+                if (done[j] || memcmp(pk[j]->raw, pk[i]->raw, sizeof(xmss_pk_t)) != 0) {
+                    continue;
+                }
+                done[j] = true;
+                member[count++] = j;
+                if (count == XMSS_VERIFY_GROUP) {
+                    xmss_verify_group(results, memo, &prf, pk[i], msg, sig, member, count);
+                    count = 0;
+                }
+            }
+            if (count > 0) {
+                xmss_verify_group(results, memo, &prf, pk[i], msg, sig, member, count);
+            }
+        }
+        free(memo);
+        free(done);
+    }
+
+    uint16_t valid = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        valid += results[i] ? 1 : 0;
+    }
+    return valid;
+}
+#endif
@@ -17,6 +17,9 @@ __INLINE void xmss_pk(xmss_pk_t *pk_out, const xmss_sk_t *sk_in) {
 
 void xmss_ltree_gen(NVCONST uint8_t *leaf, NVCONST uint8_t *tmp_wotspk, const uint8_t *pub_seed, uint16_t index);
 
+// Leaf of WOTS+ key `index` computed chain by chain with a small stack, no public key buffer
+void xmss_ltree_stream(uint8_t *leaf, const uint8_t *seed, const uint8_t *pub_seed, uint16_t index);
+
 void xmss_treehash(
     uint8_t *root_out,
     uint8_t *authpath,
@@ -24,6 +27,28 @@ void xmss_treehash(
     const uint8_t *pub_seed,
     uint16_t leaf_index);
 
+#define XMSS_TREE_CACHE_READY  0x5Au
+
+// Slot of an internal node in xmss_tree_cache_t
+__INLINE uint16_t xmss_tree_cache_slot(uint8_t height, uint16_t node_index) {
+    // level h >= 1 starts after the 256 + 128 + ... nodes of the levels below it
+    return (uint16_t) (XMSS_NUM_NODES - (XMSS_NUM_NODES >> (height - 1u)) + node_index);
+}
+
+// Computes levels 1..H from the leaves into the cache and returns the root
+void xmss_tree_cache_build(NVCONST xmss_tree_cache_t *tree,
+                           uint8_t *root_out,
+                           const uint8_t *nodes,
+                           const uint8_t *pub_seed);
+
+// Auth path of `index`: H reads from the cached tree, or rebuilding the tree if tree is
+// NULL or not ready
+void xmss_authpath(uint8_t *authpath,
+                   const uint8_t *nodes,
+                   NVCONST xmss_tree_cache_t *tree,
+                   const uint8_t *pub_seed,
+                   uint16_t index);
+
 void xmss_randombits(NVCONST uint8_t *random_bits, const uint8_t sk_seed[48]);
 
 void xmss_get_seed_i(uint8_t *seed, const xmss_sk_t *sk, uint16_t idx);
@@ -39,8 +64,31 @@ void xmss_gen_keys_2_get_nodes(
 
 void xmss_gen_keys_3_get_root(const uint8_t *xmss_nodes, NVCONST xmss_sk_t *sk);
 
+// Same as xmss_gen_keys_3_get_root, keeping every internal node in `tree`
+void xmss_gen_keys_3_build_tree(const uint8_t *xmss_nodes,
+                                NVCONST xmss_tree_cache_t *tree,
+                                NVCONST xmss_sk_t *sk);
+
+// Keygen in slices: starts (or restarts after a reset) at leaf `leaf`. Leaves are folded
+// into the tree through `stack` as they are produced, filling the tree cache on the way
+void xmss_keygen_init(xmss_keygen_ctx_t *ctx,
+                      NVCONST uint8_t *xmss_nodes,
+                      NVCONST xmss_tree_cache_t *tree,
+                      NVCONST xmss_tree_stack_t *stack,
+                      uint16_t leaf);
+
+// Computes leaves chain by chain until about `budget` hash cost is spent and returns the
+// cost spent. The slice that finishes the last leaf also writes the root to sk and
+// clears ctx->active
+uint16_t xmss_keygen_step(xmss_keygen_ctx_t *ctx,
+                          NVCONST xmss_sk_t *sk,
+                          uint16_t budget);
+
 void xmss_gen_keys(xmss_sk_t *sk, const uint8_t *sk_seed);
 
+// R of the message digest, depends on the index only
+void xmss_digest_randomness(uint8_t *R, const xmss_sk_t *sk, uint16_t index);
+
 void xmss_digest(xmss_digest_t *digest, const uint8_t msg[32], const xmss_sk_t *sk, uint16_t index);
 
 void xmss_sign(
@@ -48,13 +96,26 @@ void xmss_sign(
     const uint8_t msg[32],
     const xmss_sk_t *sk,
     const uint8_t xmss_nodes[XMSS_NODES_BUFSIZE],
+    NVCONST xmss_tree_cache_t *tree,
     uint16_t index);
 
+#define XMSS_PRECOMP_READY          0xC3u
+
+void xmss_precomp_invalidate(xmss_precomp_t *pc);
+
+bool xmss_precomp_ready(const xmss_precomp_t *pc, uint16_t index);
+
+// Fills the slot with the seed and R of `index` (two PRFs), unless it holds them already
+void xmss_precomp_fill(xmss_precomp_t *pc, const xmss_sk_t *sk, uint16_t index);
+
+// precomp may be NULL; it is used only when complete for `index`
 void xmss_sign_incremental_init(
     xmss_sig_ctx_t *ctx,
     const uint8_t msg[32],
     const xmss_sk_t *sk,
     uint8_t xmss_nodes[XMSS_NODES_BUFSIZE],
+    NVCONST xmss_tree_cache_t *tree,
+    const xmss_precomp_t *precomp,
     uint16_t index);
 
 bool xmss_sign_incremental(
@@ -68,3 +129,67 @@ bool xmss_sign_incremental_last(
     uint8_t *out,
     const xmss_sk_t *sk,
     uint16_t index);
+
+// Same signature as the incremental API, with the WOTS+ chains kept in `sig` (NV)
+// so they can be computed in idle slices before the chunks are requested
+void xmss_sign_nv_init(
+    xmss_sig_ctx_t *ctx,
+    NVCONST xmss_signature_t *sig,
+    const uint8_t msg[32],
+    const xmss_sk_t *sk,
+    uint8_t xmss_nodes[XMSS_NODES_BUFSIZE],
+    NVCONST xmss_tree_cache_t *tree,
+    const xmss_precomp_t *precomp,
+    uint16_t index);
+
+// Replaces the auth path source, e.g. the path of a signature already in NV
+void xmss_sign_nv_use_authpath(xmss_sig_ctx_t *ctx, const uint8_t *authpath);
+
+// Sets ctx up to return the chunks of the complete signature already in `sig`, no hashing
+void xmss_sign_nv_replay(xmss_sig_ctx_t *ctx, NVCONST xmss_signature_t *sig);
+
+// Does the next unit of work (a chain, then a pending auth path level) and returns its hash cost
+uint16_t xmss_sign_nv_step(xmss_sig_ctx_t *ctx, NVCONST xmss_signature_t *sig);
+
+bool xmss_sign_nv_done(const xmss_sig_ctx_t *ctx);
+
+// Completes sig->raw up to byte `end` (chains first, then the auth path) for callers that
+// read `sig` directly in their own block sizes. Returns true once `sig` is complete
+bool xmss_sign_nv_prepare(xmss_sig_ctx_t *ctx,
+                          NVCONST xmss_signature_t *sig,
+                          uint16_t index,
+                          uint16_t end);
+
+// Next chunk of the signature (same layout as xmss_sign_incremental/_last)
+// The work is balanced so every chunk does about the same number of hashes, reported in ctx->cost
+// Returns true after the last chunk, `sig` then holds the complete signature
+bool xmss_sign_nv_chunk(
+    xmss_sig_ctx_t *ctx,
+    uint8_t *out,
+    NVCONST xmss_signature_t *sig,
+    const xmss_sk_t *sk,
+    uint16_t index);
+
+// Auth path of `index` for a reader that holds the path of `cached_index`: a bitmap of the
+// levels that differ (bit h = level h) followed by those nodes, lowest level first
+// If the top level differs every level does, the plain path is written instead
+// Returns the bytes written, XMSS_AUTHPATHSIZE for the plain path and less otherwise
+uint16_t xmss_authpath_delta(uint8_t *out,
+                             const uint8_t *authpath,
+                             uint16_t index,
+                             uint16_t cached_index);
+
+bool xmss_verify(const xmss_pk_t *pk, const uint8_t msg[32], const xmss_signature_t *sig);
+
+#ifndef LEDGER_SPECIFIC
+// Signatures of the same key verified together
+#define XMSS_VERIFY_GROUP  32u
+
+// Verifies n signatures, pk[i] / msg[i] / sig[i] may repeat keys in any order
+// Sets results[i] and returns the number of valid signatures
+uint16_t xmss_verify_batch(bool results[],
+                           const xmss_pk_t *pk[],
+                           const uint8_t *msg[],
+                           const xmss_signature_t *sig[],
+                           uint16_t n);
+#endif
@@ -52,6 +52,50 @@ typedef union {
   };
 } xmss_signature_t;
 
+// Internal tree nodes, levels 1..H in level order (leaves stay in the node buffer)
+// Written once at keygen so an auth path is a handful of reads
+typedef struct {
+  uint8_t ready;
+  uint8_t nodes[XMSS_NUM_NODES - 1][WOTS_N];
+} xmss_tree_cache_t;
+
+// Message-independent signing material for one index, filled during idle time (RAM)
+typedef struct {
+  uint8_t ready;
+  uint16_t index;
+  uint8_t seed_i[WOTS_N];
+  uint8_t randomness[WOTS_N];
+} xmss_precomp_t;
+
+#define XMSS_LTREE_STK  8u
+
+// Streaming L-tree: WOTS+ public key elements folded as they are produced
+typedef struct {
+  uint8_t top;
+  uint8_t height[XMSS_LTREE_STK];
+  uint8_t node_index[XMSS_LTREE_STK];
+  uint8_t stack[XMSS_LTREE_STK][WOTS_N];
+} xmss_ltree_stack_t;
+
+// Treehash stack of a keygen in progress, kept in NV so leaves fold in across slices
+typedef struct {
+  uint8_t offset;
+  uint8_t levels[XMSS_STK_LEVELS];
+  uint8_t nodes[XMSS_STK_LEVELS][WOTS_N];
+} xmss_tree_stack_t;
+
+// Keygen split in slices. Kept in RAM, after a reset it restarts from a checkpointed leaf
+typedef struct {
+  uint8_t active;
+  uint16_t leaf;                  // leaf being computed
+  uint8_t chain;                  // next chain of that leaf
+  uint8_t seed_i[WOTS_N];
+  xmss_ltree_stack_t ltree;
+  uint8_t *xmss_nodes;
+  NVCONST xmss_tree_cache_t *tree;
+  NVCONST xmss_tree_stack_t *stack;   // folds the leaves into the tree
+} xmss_keygen_ctx_t;
+
 typedef union {
   struct {
     uint16_t written;
@@ -59,6 +103,12 @@ typedef union {
     xmss_digest_t msg_digest;
     wots_sign_ctx_t wots_ctx;
     uint8_t *xmss_nodes;
+    NVCONST xmss_tree_cache_t *tree;
+    const uint8_t *authpath;        // auth path known in advance, NULL computes it
+    const uint8_t *pub_seed;
+    uint8_t auth_levels;            // auth path levels already in authpath
+    uint8_t auth_part;              // pieces done of the level being built
+    uint16_t cost;                  // hash cost of the last chunk
   };
 } xmss_sig_ctx_t;
 #pragma pack(pop)
@@ -15,4 +15,5 @@
 ********************************************************************************/
 #include "storage.h"
 
-appstorage_t N_appdata_impl;
+// the key commit at the start stays within one NV page
+appstorage_t N_appdata_impl __attribute__((aligned(64)));
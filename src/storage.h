@@ -16,20 +16,56 @@
 #pragma once
 #include "os.h"
 #include "xmss_types.h"
+#include "nvram.h"
+
+#define LEASE_NONCE_SIZE 16u
 
 #pragma pack(push, 1)
+// State of a key slot while another one is selected, same layout as the start of appstorage_t
+typedef struct {
+  uint8_t mode;
+  uint16_t xmss_index;
+  uint8_t key_buffer;
+  uint32_t key_generation;
+  uint16_t lease_start;
+  uint16_t lease_end;
+} appslot_t;
+
 typedef union {
   struct {
     uint8_t mode;
     uint16_t xmss_index;
 
+    // N_DATA.key entry of the key in use, xor the slot number so that zeroed NV gives
+    // slot i entry i and leaves the last entry spare. Its pk is read from the entry's sk
+    uint8_t key_buffer;
+    uint32_t key_generation;        // last BIP32 path element of the key in use
+    uint16_t lease_start;           // index range of this device, kept across rotations
+    uint16_t lease_end;             // end of the range, 0 if it runs to the end of the key
+
+    uint8_t slot;                   // selected key slot, its state is in the fields above
+    uint8_t spare_buffer;           // spare N_DATA.key entry, xor XMSS_KEY_SLOTS
+    uint8_t next_mode;              // successor key in the spare entry
+
     ////
-    xmss_pk_t pk;
+    uint16_t next_index;            // its keygen checkpoint
+    uint8_t next_slot;              // slot the successor key belongs to
+    uint8_t lease_nonce[LEASE_NONCE_SIZE];  // from LEASE_REQUEST, zero once a lease used it
+    appslot_t slots[XMSS_KEY_SLOTS];
   };
   uint8_t raw[3];
+  // mode to next_mode: a key change (rotation, slot selection) commits them in this one
+  // small write, after everything it depends on is in NV
+  uint8_t raw_key[sizeof(appslot_t) + 3];
 
 } appstorage_t;
 #pragma pack(pop)
 
 extern appstorage_t N_appdata_impl;
 #define N_appdata (*(appstorage_t *)PIC(&N_appdata_impl))
+
+// Last generation a successor key can be derived for: BIP32 hardened indices are 31 bits
+#define KEY_GENERATION_MAX 0x7FFFFFFFu
+
+// First index the selected key may not sign with
+#define APP_INDEX_LIMIT (N_appdata.lease_end != 0 ? N_appdata.lease_end : 256)
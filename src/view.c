@@ -96,6 +96,15 @@ static const bagl_element_t view_setidx[] = {
         UI_LabelLineScrolling(2, 6, 30, 112, 11, 0xFFFFFF, 0x000000, (const char *) view_buffer_value),
 };
 
+static const bagl_element_t view_lease[] = {
+        UI_FillRectangle(0, 0, 0, 128, 32, 0x000000, 0xFFFFFF),
+        UI_Icon(0, 0, 0, 7, 7, BAGL_GLYPH_ICON_CROSS),
+        UI_Icon(0, 128 - 7, 0, 7, 7, BAGL_GLYPH_ICON_CHECK),
+        UI_LabelLine(1, 0, 8, 128, 11, 0xFFFFFF, 0x000000, (const char *) view_title),
+        UI_LabelLine(1, 0, 19, 128, 11, 0xFFFFFF, 0x000000, (const char *) view_buffer_key),
+        UI_LabelLineScrolling(2, 6, 30, 112, 11, 0xFFFFFF, 0x000000, (const char *) view_buffer_value),
+};
+
 void io_seproxyhal_display(const bagl_element_t *element) {
     io_seproxyhal_display_default((bagl_element_t *) element);
 }
@@ -199,6 +208,36 @@ static unsigned int view_setidx_button(unsigned int button_mask,
     return 0;
 }
 
+static unsigned int view_lease_button(unsigned int button_mask,
+                                      unsigned int button_mask_counter) {
+    switch (button_mask) {
+        // Press left to progress to cancel
+        case BUTTON_EVT_RELEASED | BUTTON_LEFT: {
+            app_lease_clear();
+
+            set_code(G_io_apdu_buffer, 0, APDU_CODE_COMMAND_NOT_ALLOWED);
+            io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, 2);
+            view_update_state(500);
+            view_main_menu();
+            break;
+        }
+
+            // Press right to progress to accept
+        case BUTTON_EVT_RELEASED | BUTTON_RIGHT: {
+            // the key or its index may have moved while the range was shown
+            const uint8_t len = app_lease_issue();
+
+            set_code(G_io_apdu_buffer, len, len != 0 ? APDU_CODE_OK : APDU_CODE_COMMAND_NOT_ALLOWED);
+            io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, len + 2);
+            view_update_state(500);
+            view_main_menu();
+            break;
+        }
+
+    }
+    return 0;
+}
+
 const bagl_element_t *view_setidx_prepro(const bagl_element_t *element) {
 
     switch (element->component.userid) {
@@ -220,9 +259,8 @@ const bagl_element_t *view_setidx_prepro(const bagl_element_t *element) {
 
 void handler_init_device(unsigned int unused) {
     UNUSED(unused);
-    while (app_initialize_xmss_step()) {
-        view_update_state(50);
-    }
+    // the ticker carries on from here
+    app_initialize_xmss_step();
     view_update_state(50);
     view_main_menu();
 }
@@ -253,6 +291,7 @@ void handler_sign_tx(unsigned int unused) {
 
 void handler_reject_tx(unsigned int unused) {
     UNUSED(unused);
+    app_sign_clear();
 
     set_code(G_io_apdu_buffer, 0, APDU_CODE_COMMAND_NOT_ALLOWED);
     io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, 2);
@@ -294,17 +333,22 @@ void view_update_state(uint16_t interval) {
         }
             break;
         case APPMODE_READY: {
-            if (N_appdata.xmss_index >= 256) {
+            const uint16_t limit = APP_INDEX_LIMIT;
+            if (N_appdata.xmss_index >= limit) {
+                if (N_appdata.next_mode == APPMODE_READY && N_appdata.next_slot == N_appdata.slot) {
+                    snprintf(view_buffer_value, sizeof(view_buffer_value), "ROTATE KEY");
+                    break;
+                }
                 snprintf(view_buffer_value, sizeof(view_buffer_value), "NO SIGS LEFT");
                 break;
             }
 
-            if (N_appdata.xmss_index > 250) {
-                snprintf(view_buffer_value, sizeof(view_buffer_value), "WARN! rem:%03d", 256 - N_appdata.xmss_index);
+            if (N_appdata.xmss_index + 6 > limit) {
+                snprintf(view_buffer_value, sizeof(view_buffer_value), "WARN! rem:%03d", limit - N_appdata.xmss_index);
                 break;
             }
 
-            snprintf(view_buffer_value, sizeof(view_buffer_value), "READY rem:%03d", 256 - N_appdata.xmss_index);
+            snprintf(view_buffer_value, sizeof(view_buffer_value), "READY rem:%03d", limit - N_appdata.xmss_index);
         }
             break;
     }
@@ -484,3 +528,11 @@ void view_setidx_show() {
 
     UX_DISPLAY(view_setidx, view_setidx_prepro);
 }
+
+void view_lease_show() {
+    strcpy(view_title, "WARNING!");
+    strcpy(view_buffer_key, "Lease XMSS Index");
+    snprintf(view_buffer_value, sizeof(view_buffer_value), "From %d to %d", ctx.lease.start, ctx.lease.end - 1);
+
+    UX_DISPLAY(view_lease, view_setidx_prepro);
+}
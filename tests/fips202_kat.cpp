@@ -0,0 +1,178 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "fips202.h"
+}
+#include "hash_backend.h"
+
+// Known answers from hashlib (OpenSSL). Input lane j of length n is
+// (i + 17 * j) & 0xFF for i < n; lengths cross the rates of SHAKE256 (136) and SHA3-512 (72)
+
+namespace {
+
+std::vector<uint8_t> message(size_t len, uint8_t lane) {
+    std::vector<uint8_t> m(len);
+    for (size_t i = 0; i < len; i++) {
+        m[i] = (uint8_t) (i + 17u * lane);
+    }
+    return m;
+}
+
+std::string hex(const uint8_t *data, size_t len) {
+    static const char digits[] = "0123456789abcdef";
+    std::string s;
+    for (size_t i = 0; i < len; i++) {
+        s += digits[data[i] >> 4u];
+        s += digits[data[i] & 0xFu];
+    }
+    return s;
+}
+
+// 300 bytes are squeezed, the last 32 are checked
+#define SHAKE_OUTLEN    300u
+#define SHAKE_TAIL      32u
+
+struct shake_kat_t {
+    size_t inlen;
+    const char *tail;
+};
+
+const shake_kat_t shake256_kat[] = {
+        {0, "73cdcd0fab882c45755feb3aed96d477ff96390bf9a66d1368b208e21f7c10d0"},
+        {1, "fcbc5b75e5aa8fd76a18b72bec9906fb1bef9d3bca1f34f7e6a057ac3c5806d6"},
+        {135, "97a138194629fc4ba1b467acb533f52668759099525c4a6da6733c2eabb3bb4a"},
+        {136, "91962dfbaa95eb700ce10e88cfa3b7911a24d648b1bf2b782c7c7a0867dbae51"},
+        {137, "96aec260c660fb61a2c4e10a262ffa559292139c76cdbda6cd0a2754dfccd964"},
+        {300, "0e043cbf2e8a09a5f185cb79a8528d434790215774e4decc106eb0ab31d9bfa8"},
+};
+
+const shake_kat_t sha3_256_kat[] = {
+        {0, "a7ffc6f8bf1ed76651c14756a061d662f580ff4de43b49fa82d80a4b80f8434a"},
+        {3, "1186d49a4ad620618f760f29da2c593b2ec2cc2ced69dc16817390d861e62253"},
+        {135, "fded8fd9d6551c601eeb3b7c6bc5e5cfd8aad1d015b7e9aaa9c9b9475231d5e2"},
+        {136, "cf3ccff92480a29160c2d38317c430e14749bfee1788106957dfe73f8c4930e5"},
+        {200, "5f728f63bf5ee48c77f453c0490398fa645b8d4c4e56be9a41cfec344d6ca899"},
+};
+
+const shake_kat_t sha3_512_kat[] = {
+        {0, "a69f73cca23a9ac5c8b567dc185a756e97c982164fe25859e0d1dcc1475c80a6"
+            "15b2123af1f5f94c11e3e9402c3ac558f500199d95b6d3e301758586281dcd26"},
+        {71, "3ccc850d53a1287af7b4560b2ef0d43eb5d9a80d62a0e9cf1dbc040135921104"
+             "d4395168e90bfc871773ebb34bca1bd67056e1cc7dc7a48ff7c3167d389f117c"},
+        {72, "5d63f2bbe971a983ac6847480106e4e1264ee3a0befd79954914e1d86e795b2e"
+             "18238f12fc5e46cb9cc78efdec610a93647cc04e1c23d8caaa6a58c21dd26c07"},
+        {200, "ea5d05f19348dd589793354793a15f37a73b4c0bb4e750b9a00757dfce2f8b65"
+              "a64191bb9b137de00feef6474cfd47abf7880efbc51614a5715df12cfe0caee3"},
+};
+
+TEST(FIPS202, Shake256) {
+    for (const auto &kat : shake256_kat) {
+        const auto m = message(kat.inlen, 0);
+        uint8_t out[SHAKE_OUTLEN];
+        shake256(out, SHAKE_OUTLEN, m.data(), m.size());
+        EXPECT_EQ(hex(out + SHAKE_OUTLEN - SHAKE_TAIL, SHAKE_TAIL), kat.tail) << "inlen " << kat.inlen;
+    }
+}
+
+TEST(FIPS202, Shake256Incremental) {
+    for (const auto &kat : shake256_kat) {
+        const auto m = message(kat.inlen, 0);
+
+        // absorb in uneven pieces, squeeze in uneven pieces
+        keccak_state state;
+        shake256_init(&state);
+        for (size_t pos = 0; pos < m.size();) {
+            const size_t piece = std::min<size_t>(m.size() - pos, 1 + pos % 61);
+            shake256_absorb(&state, m.data() + pos, piece);
+            pos += piece;
+        }
+        shake256_finalize(&state);
+
+        uint8_t out[SHAKE_OUTLEN];
+        for (size_t pos = 0; pos < SHAKE_OUTLEN;) {
+            const size_t piece = std::min<size_t>(SHAKE_OUTLEN - pos, 1 + pos % 97);
+            shake256_squeeze(out + pos, piece, &state);
+            pos += piece;
+        }
+        EXPECT_EQ(hex(out + SHAKE_OUTLEN - SHAKE_TAIL, SHAKE_TAIL), kat.tail) << "inlen " << kat.inlen;
+    }
+}
+
+TEST(FIPS202, Sha3) {
+    for (const auto &kat : sha3_256_kat) {
+        const auto m = message(kat.inlen, 0);
+        uint8_t out[32];
+        keccak_state state;
+        sha3_256_init(&state);
+        sha3_256_absorb(&state, m.data(), m.size());
+        sha3_256_finalize(out, &state);
+        EXPECT_EQ(hex(out, 32), kat.tail) << "inlen " << kat.inlen;
+    }
+    for (const auto &kat : sha3_512_kat) {
+        const auto m = message(kat.inlen, 0);
+        uint8_t out[64];
+        keccak_state state;
+        sha3_512_init(&state);
+        sha3_512_absorb(&state, m.data(), m.size());
+        sha3_512_finalize(out, &state);
+        EXPECT_EQ(hex(out, 64), kat.tail) << "inlen " << kat.inlen;
+    }
+}
+
+// Every backend the CPU supports, including the AVX2 lanes of shake256_x4
+TEST(FIPS202, Shake256Backends) {
+    for (uint8_t b = 0; b < hash_backend_count(); b++) {
+        const hash_backend_t *backend = hash_backend_get(b);
+        if (backend == nullptr) {
+            continue;
+        }
+
+        for (const auto &kat : shake256_kat) {
+            std::vector<uint8_t> m[4];
+            const uint8_t *in[4];
+            uint8_t out[4][SHAKE_OUTLEN];
+            uint8_t *out_p[4];
+            for (uint8_t j = 0; j < 4; j++) {
+                m[j] = message(kat.inlen, j);
+                in[j] = m[j].data();
+                out_p[j] = out[j];
+            }
+
+            uint8_t single[SHAKE_OUTLEN];
+            backend->shake256(single, SHAKE_OUTLEN, in[0], kat.inlen);
+            EXPECT_EQ(hex(single + SHAKE_OUTLEN - SHAKE_TAIL, SHAKE_TAIL), kat.tail)
+                                << backend->name << " inlen " << kat.inlen;
+
+            backend->shake256_x4(out_p, SHAKE_OUTLEN, in, kat.inlen);
+            EXPECT_EQ(hex(out[0] + SHAKE_OUTLEN - SHAKE_TAIL, SHAKE_TAIL), kat.tail)
+                                << backend->name << " x4 inlen " << kat.inlen;
+
+            // the other lanes against the scalar code
+            for (uint8_t j = 1; j < 4; j++) {
+                shake256(single, SHAKE_OUTLEN, in[j], kat.inlen);
+                EXPECT_EQ(hex(out[j], SHAKE_OUTLEN), hex(single, SHAKE_OUTLEN))
+                                    << backend->name << " x4 lane " << (int) j << " inlen " << kat.inlen;
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,141 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include <cstring>
+#include <string>
+#include <vector>
+#include <openssl/sha.h>
+
+extern "C" {
+#include "xmss.h"
+}
+#include "hash_backend.h"
+
+// Runtime backend selection: every backend the CPU supports hashes like OpenSSL, and
+// switching backends does not change WOTS+ keys or leaves
+
+namespace {
+
+std::vector<uint8_t> message(size_t len, uint16_t i) {
+    std::vector<uint8_t> m(len);
+    for (size_t k = 0; k < len; k++) {
+        m[k] = (uint8_t) (k * 7u + i);
+    }
+    return m;
+}
+
+// Restores the backend picked at startup when a test is done
+class HashBackend : public ::testing::Test {
+protected:
+    void SetUp() override {
+        initial = hash_backend()->name;
+    }
+
+    void TearDown() override {
+        ASSERT_TRUE(hash_backend_select(initial.c_str()));
+    }
+
+    std::string initial;
+};
+
+TEST_F(HashBackend, DefaultIsSupported) {
+    const hash_backend_t *current = hash_backend();
+    ASSERT_NE(current, nullptr);
+
+    // the default is the first supported one in order of preference
+    for (uint8_t b = 0; b < hash_backend_count(); b++) {
+        const hash_backend_t *backend = hash_backend_get(b);
+        if (backend != nullptr) {
+            EXPECT_STREQ(backend->name, current->name);
+            break;
+        }
+    }
+
+    EXPECT_FALSE(hash_backend_select("none"));
+    EXPECT_STREQ(hash_backend()->name, current->name);
+    EXPECT_EQ(hash_backend_get(hash_backend_count()), nullptr);
+}
+
+TEST_F(HashBackend, Sha256AgainstOpenSSL) {
+    const uint16_t counts[] = {1, 2, 3, 8, 9, 17};
+    const uint16_t lengths[] = {0, 32, 55, 56, 64, 96, 128, 160};
+
+    for (uint8_t b = 0; b < hash_backend_count(); b++) {
+        const hash_backend_t *backend = hash_backend_get(b);
+        if (backend == nullptr) {
+            continue;
+        }
+        for (auto len : lengths) {
+            uint8_t out[32];
+            uint8_t expected[32];
+            const auto m = message(len, 0);
+            backend->sha256(out, m.data(), len);
+            SHA256(m.data(), len, expected);
+            EXPECT_EQ(memcmp(out, expected, 32), 0) << backend->name << " len " << len;
+
+            for (auto count : counts) {
+                std::vector<std::vector<uint8_t>> mi(count);
+                std::vector<const uint8_t *> in(count);
+                std::vector<uint8_t> outs(count * 32u);
+                std::vector<uint8_t *> out_p(count);
+                for (uint16_t i = 0; i < count; i++) {
+                    mi[i] = message(len, i);
+                    in[i] = mi[i].data();
+                    out_p[i] = outs.data() + 32u * i;
+                }
+                backend->sha256_xN(out_p.data(), in.data(), len, count);
+                for (uint16_t i = 0; i < count; i++) {
+                    SHA256(mi[i].data(), len, expected);
+                    EXPECT_EQ(memcmp(out_p[i], expected, 32), 0)
+                                        << backend->name << " len " << len << " count " << count << " lane " << i;
+                }
+            }
+        }
+    }
+}
+
+TEST_F(HashBackend, SameKeysOnEveryBackend) {
+    const auto seed = message(32, 1);
+    const auto pub_seed = message(32, 2);
+
+    std::vector<uint8_t> first_pk;
+    std::vector<uint8_t> first_leaf;
+    for (uint8_t b = 0; b < hash_backend_count(); b++) {
+        const hash_backend_t *backend = hash_backend_get(b);
+        if (backend == nullptr) {
+            continue;
+        }
+        ASSERT_TRUE(hash_backend_select(backend->name));
+        ASSERT_STREQ(hash_backend()->name, backend->name);
+
+        std::vector<uint8_t> pk(WOTS_LEN * WOTS_N);
+        std::vector<uint8_t> leaf(WOTS_N);
+        std::vector<uint8_t> sk(seed);
+        wotsp_gen_pk(pk.data(), sk.data(), pub_seed.data(), 5);
+        xmss_ltree_gen(leaf.data(), pk.data(), pub_seed.data(), 5);
+
+        if (first_pk.empty()) {
+            first_pk = pk;
+            first_leaf = leaf;
+            continue;
+        }
+        EXPECT_EQ(pk, first_pk) << backend->name;
+        EXPECT_EQ(leaf, first_leaf) << backend->name;
+    }
+}
+
+}
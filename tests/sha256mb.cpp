@@ -0,0 +1,167 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include <cstring>
+#include <string>
+#include <vector>
+#include <openssl/sha.h>
+
+#include "sha256mb.h"
+#include "hash_backend.h"
+
+// Multi-buffer SHA-256 against OpenSSL. Message i of length n is (k + 29 * i) & 0xFF for
+// k < n; counts cross the lane widths (2 for SHA-NI, 8 for AVX2) and lengths cross the
+// padding boundaries of one and two blocks
+
+namespace {
+
+typedef void (*sha256mb_fn)(uint8_t *out[],
+                            const uint32_t state[8],
+                            uint16_t prefix_len,
+                            const uint8_t *in[],
+                            uint16_t in_len,
+                            uint16_t count);
+
+struct engine_t {
+    const char *name;           // backend that has to be supported to run it
+    sha256mb_fn fn;
+};
+
+const engine_t engines[] = {
+        {"portable", sha256mb_portable},
+#if defined(__x86_64__)
+        {"avx2", sha256mb_avx2},
+        {"shani", sha256mb_shani},
+#endif
+};
+
+const uint16_t counts[] = {1, 2, 3, 7, 8, 9, 15, 16, 17, 33};
+const uint16_t lengths[] = {0, 1, 31, 32, 55, 56, 63, 64, 65, 96, 119, 120, 128, 160, 200};
+
+bool supported(const char *name) {
+    for (uint8_t b = 0; b < hash_backend_count(); b++) {
+        const hash_backend_t *backend = hash_backend_get(b);
+        if (backend != nullptr && strcmp(backend->name, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<uint8_t> message(size_t len, uint16_t i) {
+    std::vector<uint8_t> m(len);
+    for (size_t k = 0; k < len; k++) {
+        m[k] = (uint8_t) (k + 29u * i);
+    }
+    return m;
+}
+
+// Runs `count` messages of `len` bytes through fn, after `prefix` if it is not empty
+void check(const engine_t &engine, const std::vector<uint8_t> &prefix, uint16_t count, uint16_t len) {
+    std::vector<std::vector<uint8_t>> m(count);
+    std::vector<const uint8_t *> in(count);
+    std::vector<uint8_t> out(count * 32u);
+    std::vector<uint8_t *> out_p(count);
+    for (uint16_t i = 0; i < count; i++) {
+        m[i] = message(len, i);
+        in[i] = m[i].data();
+        out_p[i] = out.data() + 32u * i;
+    }
+
+    uint32_t state[8];
+    if (!prefix.empty()) {
+        sha256mb_prefix(state, prefix.data(), (uint16_t) prefix.size());
+    }
+    engine.fn(out_p.data(), prefix.empty() ? nullptr : state, (uint16_t) prefix.size(), in.data(), len, count);
+
+    for (uint16_t i = 0; i < count; i++) {
+        std::vector<uint8_t> full(prefix);
+        full.insert(full.end(), m[i].begin(), m[i].end());
+        uint8_t expected[32];
+        SHA256(full.data(), full.size(), expected);
+        EXPECT_EQ(memcmp(out_p[i], expected, 32), 0)
+                            << engine.name << " prefix " << prefix.size() << " count " << count
+                            << " len " << len << " lane " << i;
+    }
+}
+
+TEST(SHA256MB, AgainstOpenSSL) {
+    for (const auto &engine : engines) {
+        if (!supported(engine.name)) {
+            continue;
+        }
+        for (auto count : counts) {
+            for (auto len : lengths) {
+                check(engine, std::vector<uint8_t>(), count, len);
+            }
+        }
+    }
+}
+
+TEST(SHA256MB, ResumeFromPrefix) {
+    for (const auto &engine : engines) {
+        if (!supported(engine.name)) {
+            continue;
+        }
+        for (uint16_t blocks = 1; blocks <= 2; blocks++) {
+            const auto prefix = message(64u * blocks, 100);
+            for (auto count : counts) {
+                for (auto len : lengths) {
+                    check(engine, prefix, count, len);
+                }
+            }
+        }
+    }
+}
+
+// PRF of every backend: SHA-256 of the 64-byte prefix followed by a 32-byte input
+TEST(SHA256MB, PrfBackends) {
+    const auto prefix = message(64, 200);
+    hash_midstate_t mid;
+    hash_midstate_init(&mid, prefix.data());
+
+    for (uint8_t b = 0; b < hash_backend_count(); b++) {
+        const hash_backend_t *backend = hash_backend_get(b);
+        if (backend == nullptr) {
+            continue;
+        }
+        for (auto count : counts) {
+            std::vector<std::vector<uint8_t>> m(count);
+            std::vector<const uint8_t *> in(count);
+            std::vector<uint8_t> out(count * 32u);
+            std::vector<uint8_t *> out_p(count);
+            for (uint16_t i = 0; i < count; i++) {
+                m[i] = message(32, i);
+                in[i] = m[i].data();
+                out_p[i] = out.data() + 32u * i;
+            }
+
+            backend->prf_xN(out_p.data(), &mid, in.data(), count);
+
+            for (uint16_t i = 0; i < count; i++) {
+                std::vector<uint8_t> full(prefix);
+                full.insert(full.end(), m[i].begin(), m[i].end());
+                uint8_t expected[32];
+                SHA256(full.data(), full.size(), expected);
+                EXPECT_EQ(memcmp(out_p[i], expected, 32), 0)
+                                    << backend->name << " count " << count << " lane " << i;
+            }
+        }
+    }
+}
+
+}
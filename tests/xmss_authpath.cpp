@@ -0,0 +1,118 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+
+#include "xmss_key.h"
+
+// Auth path delta: a reader holding the path of one index rebuilds the path of another from
+// the bitmap and the nodes, exactly as the full path computed from the tree
+
+namespace {
+
+class XmssAuthpath : public ::testing::Test {
+protected:
+    static void SetUpTestCase() {
+        key = xmss_test_key(5).release();
+    }
+
+    static void TearDownTestCase() {
+        delete key;
+    }
+
+    static void authpath(uint8_t out[XMSS_AUTHPATHSIZE], uint16_t index) {
+        xmss_authpath(out, key->nodes, &key->tree, key->sk.pub_seed, index);
+    }
+
+    // What the host does with the reply: the plain path, or the cached one with the listed levels replaced
+    static void apply(uint8_t path[XMSS_AUTHPATHSIZE], const uint8_t *delta, uint16_t len) {
+        if (len == XMSS_AUTHPATHSIZE) {
+            memcpy(path, delta, XMSS_AUTHPATHSIZE);
+            return;
+        }
+        uint16_t offset = 1;
+        for (uint8_t h = 0; h < XMSS_H; h++) {
+            if (delta[0] & (1u << h)) {
+                memcpy(path + h * WOTS_N, delta + offset, WOTS_N);
+                offset += WOTS_N;
+            }
+        }
+        EXPECT_EQ(offset, len);
+    }
+
+    // Rebuilds the path of `index` from that of `cached_index` and returns the delta size
+    static uint16_t check(uint16_t index, uint16_t cached_index) {
+        uint8_t expected[XMSS_AUTHPATHSIZE];
+        uint8_t path[XMSS_AUTHPATHSIZE];
+        authpath(expected, index);
+        authpath(path, cached_index);
+
+        uint8_t delta[XMSS_AUTHPATHSIZE];
+        const uint16_t len = xmss_authpath_delta(delta, expected, index, cached_index);
+        EXPECT_LE(len, XMSS_AUTHPATHSIZE);
+        apply(path, delta, len);
+        EXPECT_EQ(memcmp(path, expected, XMSS_AUTHPATHSIZE), 0) << "index " << index << " cached " << cached_index;
+        return len;
+    }
+
+    static xmss_test_key_t *key;
+};
+
+xmss_test_key_t *XmssAuthpath::key;
+
+TEST_F(XmssAuthpath, ConsecutiveIndices) {
+    uint32_t total = 0;
+    for (uint16_t index = 1; index < XMSS_NUM_NODES; index++) {
+        const uint16_t len = check(index, (uint16_t) (index - 1u));
+        if (index == XMSS_NUM_NODES / 2) {
+            EXPECT_EQ(len, XMSS_AUTHPATHSIZE);
+        } else {
+            EXPECT_LT(len, XMSS_AUTHPATHSIZE) << "index " << index;
+            total += (len - 1u) / WOTS_N;
+        }
+    }
+    // about 2 nodes on average
+    EXPECT_LE(total, 2u * (XMSS_NUM_NODES - 2u));
+}
+
+TEST_F(XmssAuthpath, TopLevelChange) {
+    for (uint16_t index : {128, 129, 200, 255}) {
+        for (uint16_t cached_index : {0, 1, 64, 127}) {
+            EXPECT_EQ(check(index, cached_index), XMSS_AUTHPATHSIZE);
+            EXPECT_EQ(check(cached_index, index), XMSS_AUTHPATHSIZE);
+        }
+    }
+}
+
+TEST_F(XmssAuthpath, SameIndex) {
+    for (uint16_t index : {0, 5, 127, 128, 255}) {
+        uint8_t path[XMSS_AUTHPATHSIZE];
+        uint8_t delta[XMSS_AUTHPATHSIZE];
+        authpath(path, index);
+        ASSERT_EQ(xmss_authpath_delta(delta, path, index, index), 1);
+        EXPECT_EQ(delta[0], 0);
+    }
+}
+
+TEST_F(XmssAuthpath, AnyPair) {
+    for (uint16_t index = 0; index < XMSS_NUM_NODES; index += 13) {
+        for (uint16_t cached_index = 0; cached_index < XMSS_NUM_NODES; cached_index += 11) {
+            check(index, cached_index);
+        }
+    }
+}
+
+}
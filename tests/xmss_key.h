@@ -0,0 +1,62 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+#include <cstring>
+#include <memory>
+
+extern "C" {
+#include "xmss.h"
+}
+
+// Host key for the tests: seeds from a fixed 48-byte seed, all leaves and the tree cache
+struct xmss_test_key_t {
+    xmss_sk_t sk;
+    uint8_t nodes[XMSS_NODES_BUFSIZE];
+    xmss_tree_cache_t tree;
+
+    xmss_pk_t pk() const {
+        xmss_pk_t pk;
+        xmss_pk(&pk, &sk);
+        return pk;
+    }
+
+    void sign(xmss_signature_t *sig, const uint8_t msg[32], uint16_t index) {
+        xmss_sign(sig, msg, &sk, nodes, &tree, index);
+    }
+};
+
+inline void xmss_test_seed(uint8_t seed[48], uint8_t tag) {
+    for (uint8_t i = 0; i < 48; i++) {
+        seed[i] = (uint8_t) (i * 3u + tag);
+    }
+}
+
+inline std::unique_ptr<xmss_test_key_t> xmss_test_key(uint8_t tag) {
+    std::unique_ptr<xmss_test_key_t> key(new xmss_test_key_t);
+    memset(key.get(), 0, sizeof(xmss_test_key_t));
+
+    uint8_t seed[48];
+    xmss_test_seed(seed, tag);
+    xmss_gen_keys_1_get_seeds(&key->sk, seed);
+
+    uint8_t wots_buffer[WOTS_LEN * WOTS_N];
+    for (uint16_t idx = 0; idx < XMSS_NUM_NODES; idx++) {
+        xmss_gen_keys_2_get_nodes(wots_buffer, key->nodes + idx * WOTS_N, &key->sk, idx);
+    }
+    xmss_gen_keys_3_build_tree(key->nodes, &key->tree, &key->sk);
+    return key;
+}
@@ -0,0 +1,126 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+
+#include "xmss_key.h"
+
+// Keygen in slices gives the leaves, tree cache and root of the one-shot keygen, also when
+// the RAM state is lost and the keygen restarts from a checkpoint (a multiple of 16 leaves)
+
+namespace {
+
+const uint16_t budget = 300;
+const uint16_t checkpoint_leaves = 16;
+
+// Key of the slices: NV state plus the RAM context
+struct sliced_key_t {
+    xmss_sk_t sk;
+    uint8_t nodes[XMSS_NODES_BUFSIZE];
+    xmss_tree_cache_t tree;
+    xmss_tree_stack_t stack;
+    xmss_keygen_ctx_t ctx;
+};
+
+class XmssKeygen : public ::testing::Test {
+protected:
+    static void SetUpTestCase() {
+        key = xmss_test_key(6).release();
+    }
+
+    static void TearDownTestCase() {
+        delete key;
+    }
+
+    void SetUp() override {
+        start();
+    }
+
+    // Fresh NV state with the seeds of `key`
+    void start() {
+        sliced.reset(new sliced_key_t);
+        memset(sliced.get(), 0, sizeof(sliced_key_t));
+
+        uint8_t seed[48];
+        xmss_test_seed(seed, 6);
+        xmss_gen_keys_1_get_seeds(&sliced->sk, seed);
+    }
+
+    // Runs slices until `stop` leaves are done or the keygen finishes
+    void run(uint16_t stop) {
+        uint16_t slices = 0;
+        while (sliced->ctx.active && sliced->ctx.leaf < stop) {
+            const uint16_t cost = xmss_keygen_step(&sliced->ctx, &sliced->sk, budget);
+            ASSERT_GT(cost, 0);
+            ASSERT_LT(++slices, 60000);
+        }
+    }
+
+    void expect_same_key() {
+        EXPECT_FALSE(sliced->ctx.active);
+        EXPECT_EQ(memcmp(sliced->sk.root, key->sk.root, WOTS_N), 0);
+        EXPECT_EQ(memcmp(sliced->nodes, key->nodes, XMSS_NODES_BUFSIZE), 0);
+        EXPECT_EQ(sliced->tree.ready, XMSS_TREE_CACHE_READY);
+        EXPECT_EQ(memcmp(sliced->tree.nodes, key->tree.nodes, sizeof(key->tree.nodes)), 0);
+    }
+
+    std::unique_ptr<sliced_key_t> sliced;
+    static xmss_test_key_t *key;
+};
+
+xmss_test_key_t *XmssKeygen::key;
+
+TEST_F(XmssKeygen, SlicesMatchBuildTree) {
+    xmss_keygen_init(&sliced->ctx, sliced->nodes, &sliced->tree, &sliced->stack, 0);
+    EXPECT_NE(sliced->tree.ready, XMSS_TREE_CACHE_READY);
+    run(XMSS_NUM_NODES);
+    expect_same_key();
+
+    // a finished keygen does no more work
+    EXPECT_EQ(xmss_keygen_step(&sliced->ctx, &sliced->sk, budget), 0);
+}
+
+TEST_F(XmssKeygen, ResumeFromCheckpoint) {
+    for (uint16_t stop : {1, 16, 17, 50, 128, 200, 255}) {
+        start();
+        SCOPED_TRACE(testing::Message() << "stop " << stop);
+
+        xmss_keygen_init(&sliced->ctx, sliced->nodes, &sliced->tree, &sliced->stack, 0);
+        run(stop);
+        // mid-leaf, as a reset would leave it
+        xmss_keygen_step(&sliced->ctx, &sliced->sk, 10);
+
+        // the RAM context is lost, NV holds the work past the checkpoint as well
+        const uint16_t checkpoint = (uint16_t) (sliced->ctx.leaf & ~(checkpoint_leaves - 1u));
+        memset(&sliced->ctx, 0xA5, sizeof(xmss_keygen_ctx_t));
+        xmss_keygen_init(&sliced->ctx, sliced->nodes, &sliced->tree, &sliced->stack, checkpoint);
+        EXPECT_EQ(sliced->ctx.leaf, checkpoint);
+        run(XMSS_NUM_NODES);
+        expect_same_key();
+    }
+}
+
+TEST_F(XmssKeygen, ResumeTwice) {
+    xmss_keygen_init(&sliced->ctx, sliced->nodes, &sliced->tree, &sliced->stack, 0);
+    run(40);
+    xmss_keygen_init(&sliced->ctx, sliced->nodes, &sliced->tree, &sliced->stack, 32);
+    run(170);
+    xmss_keygen_init(&sliced->ctx, sliced->nodes, &sliced->tree, &sliced->stack, 160);
+    run(XMSS_NUM_NODES);
+    expect_same_key();
+}
+
+}
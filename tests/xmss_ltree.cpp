@@ -0,0 +1,68 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include <vector>
+
+#include "xmss_key.h"
+
+// The streaming L-tree (chain by chain, no public key buffer) gives the same leaf as the
+// WOTS+ public key followed by the batched L-tree
+
+namespace {
+
+std::vector<uint8_t> message(size_t len, uint16_t i) {
+    std::vector<uint8_t> m(len);
+    for (size_t k = 0; k < len; k++) {
+        m[k] = (uint8_t) (k * 11u + i);
+    }
+    return m;
+}
+
+void expect_same_leaf(const uint8_t *seed, const uint8_t *pub_seed, uint16_t index) {
+    std::vector<uint8_t> sk(seed, seed + WOTS_N);
+    std::vector<uint8_t> pk(WOTS_LEN * WOTS_N);
+    uint8_t expected[WOTS_N];
+    wotsp_gen_pk(pk.data(), sk.data(), pub_seed, index);
+    xmss_ltree_gen(expected, pk.data(), pub_seed, index);
+
+    uint8_t leaf[WOTS_N];
+    xmss_ltree_stream(leaf, seed, pub_seed, index);
+    EXPECT_EQ(memcmp(leaf, expected, WOTS_N), 0) << "index " << index;
+}
+
+TEST(XmssLtree, StreamMatchesGen) {
+    for (uint16_t index : {0, 1, 2, 15, 16, 127, 128, 254, 255}) {
+        const auto seed = message(WOTS_N, index);
+        const auto pub_seed = message(WOTS_N, (uint16_t) (index + 100u));
+        expect_same_leaf(seed.data(), pub_seed.data(), index);
+    }
+}
+
+TEST(XmssLtree, StreamMatchesKeyLeaves) {
+    const auto key = xmss_test_key(3);
+    for (uint16_t index = 0; index < XMSS_NUM_NODES; index += 17) {
+        uint8_t seed[WOTS_N];
+        xmss_get_seed_i(seed, &key->sk, index);
+        expect_same_leaf(seed, key->sk.pub_seed, index);
+
+        uint8_t leaf[WOTS_N];
+        xmss_ltree_stream(leaf, seed, key->sk.pub_seed, index);
+        EXPECT_EQ(memcmp(leaf, key->nodes + index * WOTS_N, WOTS_N), 0) << "index " << index;
+    }
+}
+
+}
@@ -0,0 +1,190 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include <vector>
+
+#include "xmss_key.h"
+
+// Signatures built in NV (chunk by chunk, or up to a byte offset) are byte for byte the
+// signature of xmss_sign, with and without the tree cache and the precomputed seed and R
+
+namespace {
+
+const uint16_t indices[] = {0, 1, 31, 32, 127, 128, 255};
+
+class XmssSignNv : public ::testing::Test {
+protected:
+    static void SetUpTestCase() {
+        key = xmss_test_key(4).release();
+    }
+
+    static void TearDownTestCase() {
+        delete key;
+    }
+
+    static void message(uint8_t msg[32], uint16_t index) {
+        for (uint8_t i = 0; i < 32; i++) {
+            msg[i] = (uint8_t) (index * 7u + i);
+        }
+    }
+
+    // tree is the key's cache or NULL, precomp is filled for `index` or NULL
+    static void init(xmss_sig_ctx_t *ctx, xmss_signature_t *sig, bool cached, bool precomputed, uint16_t index) {
+        uint8_t msg[32];
+        message(msg, index);
+
+        xmss_precomp_t pc;
+        xmss_precomp_invalidate(&pc);
+        if (precomputed) {
+            xmss_precomp_fill(&pc, &key->sk, index);
+        }
+
+        memset(ctx, 0, sizeof(xmss_sig_ctx_t));
+        memset(sig, 0xEE, sizeof(xmss_signature_t));
+        xmss_sign_nv_init(ctx, sig, msg, &key->sk, key->nodes,
+                          cached ? &key->tree : nullptr, precomputed ? &pc : nullptr, index);
+    }
+
+    static void expected(xmss_signature_t *sig, uint16_t index) {
+        uint8_t msg[32];
+        message(msg, index);
+        key->sign(sig, msg, index);
+    }
+
+    static xmss_test_key_t *key;
+};
+
+xmss_test_key_t *XmssSignNv::key;
+
+TEST_F(XmssSignNv, ChunksMatchSign) {
+    for (int cached = 0; cached < 2; cached++) {
+        for (int precomputed = 0; precomputed < 2; precomputed++) {
+            for (auto index : indices) {
+                SCOPED_TRACE(testing::Message() << "cached " << cached << " precomp " << precomputed
+                                                << " index " << index);
+                xmss_signature_t reference;
+                expected(&reference, index);
+
+                xmss_sig_ctx_t ctx;
+                xmss_signature_t sig;
+                init(&ctx, &sig, cached != 0, precomputed != 0, index);
+
+                std::vector<uint8_t> out;
+                uint8_t chunk[XMSS_AUTHPATHSIZE];
+                bool last = false;
+                uint8_t chunks = 0;
+                while (!last && chunks < 20) {
+                    last = xmss_sign_nv_chunk(&ctx, chunk, &sig, &key->sk, index);
+                    // same layout as xmss_sign_incremental: 164 bytes, 9 x 224, then the auth path
+                    const uint16_t size = chunks == 0 ? 164 : (chunks == 10 ? XMSS_AUTHPATHSIZE : 224);
+                    EXPECT_EQ(ctx.written, size) << "chunk " << (int) chunks;
+                    out.insert(out.end(), chunk, chunk + ctx.written);
+                    chunks++;
+                }
+                EXPECT_EQ(chunks, 11);
+                ASSERT_EQ(out.size(), (size_t) XMSS_SIGSIZE);
+                EXPECT_EQ(memcmp(out.data(), reference.raw, XMSS_SIGSIZE), 0);
+                EXPECT_EQ(memcmp(sig.raw, reference.raw, XMSS_SIGSIZE), 0);
+
+                // nothing more once complete
+                EXPECT_TRUE(xmss_sign_nv_chunk(&ctx, chunk, &sig, &key->sk, index));
+                EXPECT_EQ(ctx.written, 0);
+            }
+        }
+    }
+}
+
+TEST_F(XmssSignNv, ReplayReturnsSameChunks) {
+    const uint16_t index = 77;
+    xmss_signature_t reference;
+    expected(&reference, index);
+
+    xmss_sig_ctx_t ctx;
+    xmss_signature_t sig;
+    init(&ctx, &sig, true, false, index);
+    uint8_t chunk[XMSS_AUTHPATHSIZE];
+    while (!xmss_sign_nv_chunk(&ctx, chunk, &sig, &key->sk, index)) {
+    }
+
+    xmss_sign_nv_replay(&ctx, &sig);
+    std::vector<uint8_t> out;
+    bool last = false;
+    while (!last) {
+        last = xmss_sign_nv_chunk(&ctx, chunk, &sig, &key->sk, index);
+        EXPECT_EQ(ctx.cost, 0);
+        out.insert(out.end(), chunk, chunk + ctx.written);
+    }
+    ASSERT_EQ(out.size(), (size_t) XMSS_SIGSIZE);
+    EXPECT_EQ(memcmp(out.data(), reference.raw, XMSS_SIGSIZE), 0);
+}
+
+
+TEST_F(XmssSignNv, PrepareMatchesSign) {
+    const uint16_t wots_end = 4 + 32 + WOTS_SIGSIZE;
+    const uint16_t ends[] = {1, 36, 37, 68, 69, 500, wots_end - 1, wots_end, wots_end + 1, XMSS_SIGSIZE};
+
+    for (int cached = 0; cached < 2; cached++) {
+        for (int precomputed = 0; precomputed < 2; precomputed++) {
+            for (auto index : indices) {
+                SCOPED_TRACE(testing::Message() << "cached " << cached << " precomp " << precomputed
+                                                << " index " << index);
+                xmss_signature_t reference;
+                expected(&reference, index);
+
+                xmss_sig_ctx_t ctx;
+                xmss_signature_t sig;
+                init(&ctx, &sig, cached != 0, precomputed != 0, index);
+
+                // every call completes at least the bytes before `end`, and the whole
+                // signature once `end` is past the WOTS+ chains
+                for (auto end : ends) {
+                    const bool complete = xmss_sign_nv_prepare(&ctx, &sig, index, end);
+                    EXPECT_EQ(complete, end > wots_end) << "end " << end;
+                    EXPECT_EQ(memcmp(sig.raw, reference.raw, complete ? XMSS_SIGSIZE : end), 0) << "end " << end;
+                }
+                EXPECT_TRUE(xmss_sign_nv_done(&ctx));
+            }
+        }
+    }
+}
+
+TEST_F(XmssSignNv, ChunksAfterPrepare) {
+    // part of the signature read directly, then the chunks pick up from there
+    for (uint16_t end : {100u, 1000u, (unsigned) XMSS_SIGSIZE}) {
+        const uint16_t index = 200;
+        xmss_signature_t reference;
+        expected(&reference, index);
+
+        xmss_sig_ctx_t ctx;
+        xmss_signature_t sig;
+        init(&ctx, &sig, false, false, index);
+        xmss_sign_nv_prepare(&ctx, &sig, index, end);
+
+        std::vector<uint8_t> out;
+        uint8_t chunk[XMSS_AUTHPATHSIZE];
+        bool last = false;
+        while (!last) {
+            last = xmss_sign_nv_chunk(&ctx, chunk, &sig, &key->sk, index);
+            out.insert(out.end(), chunk, chunk + ctx.written);
+        }
+        ASSERT_EQ(out.size(), (size_t) XMSS_SIGSIZE) << "end " << end;
+        EXPECT_EQ(memcmp(out.data(), reference.raw, XMSS_SIGSIZE), 0) << "end " << end;
+        EXPECT_EQ(memcmp(sig.raw, reference.raw, XMSS_SIGSIZE), 0) << "end " << end;
+    }
+}
+
+}
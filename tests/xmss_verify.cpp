@@ -0,0 +1,190 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include <vector>
+
+#include "xmss_key.h"
+
+// xmss_verify and xmss_verify_batch on signatures of two host keys, intact and tampered
+// in each part: auth path, WOTS+ signature, randomness, index, message and key
+
+namespace {
+
+enum tamper_t {
+    TAMPER_NONE,
+    TAMPER_AUTHPATH,
+    TAMPER_WOTS,
+    TAMPER_RANDOMNESS,
+    TAMPER_INDEX,
+    TAMPER_MSG,
+};
+
+struct signed_msg_t {
+    xmss_pk_t pk;
+    uint8_t msg[32];
+    xmss_signature_t sig;
+    bool valid;
+};
+
+class XmssVerify : public ::testing::Test {
+protected:
+    static void SetUpTestCase() {
+        keys[0] = xmss_test_key(1).release();
+        keys[1] = xmss_test_key(2).release();
+    }
+
+    static void TearDownTestCase() {
+        delete keys[0];
+        delete keys[1];
+    }
+
+    // Signature of key k at `index`, then damaged as `tamper` says. `where` picks the byte
+    static signed_msg_t make(uint8_t k, uint16_t index, tamper_t tamper, uint16_t where) {
+        signed_msg_t s;
+        s.pk = keys[k]->pk();
+        for (uint8_t i = 0; i < 32; i++) {
+            s.msg[i] = (uint8_t) (index + i * 5u + k);
+        }
+        keys[k]->sign(&s.sig, s.msg, index);
+        s.valid = tamper == TAMPER_NONE;
+
+        switch (tamper) {
+            case TAMPER_NONE:
+                break;
+            case TAMPER_AUTHPATH:
+                s.sig.auth_path[where % XMSS_AUTHPATHSIZE] ^= 0x01;
+                break;
+            case TAMPER_WOTS:
+                s.sig.wots_sig[where % WOTS_SIGSIZE] ^= 0x80;
+                break;
+            case TAMPER_RANDOMNESS:
+                s.sig.randomness[where % 32] ^= 0x10;
+                break;
+            case TAMPER_INDEX:
+                s.sig.index = NtoHL((uint32_t) ((index ^ (1u << (where % XMSS_H))) & 0xFFu));
+                break;
+            case TAMPER_MSG:
+                s.msg[where % 32] ^= 0x02;
+                break;
+        }
+        return s;
+    }
+
+    static xmss_test_key_t *keys[2];
+};
+
+xmss_test_key_t *XmssVerify::keys[2];
+
+TEST_F(XmssVerify, ValidSignatures) {
+    for (uint16_t index : {0, 1, 2, 127, 128, 200, 254, 255}) {
+        const auto s = make(0, index, TAMPER_NONE, 0);
+        EXPECT_TRUE(xmss_verify(&s.pk, s.msg, &s.sig)) << "index " << index;
+    }
+}
+
+TEST_F(XmssVerify, TamperedAuthPath) {
+    // one flipped bit on every level
+    for (uint16_t h = 0; h < XMSS_H; h++) {
+        const auto s = make(0, 77, TAMPER_AUTHPATH, h * WOTS_N + h);
+        EXPECT_FALSE(xmss_verify(&s.pk, s.msg, &s.sig)) << "level " << h;
+    }
+}
+
+TEST_F(XmssVerify, TamperedWotsSignature) {
+    // first and last chain of the message part and the checksum
+    for (uint16_t chain : {0, 1, 63, 64, 66}) {
+        const auto s = make(0, 42, TAMPER_WOTS, chain * WOTS_N + 31);
+        EXPECT_FALSE(xmss_verify(&s.pk, s.msg, &s.sig)) << "chain " << chain;
+    }
+}
+
+TEST_F(XmssVerify, TamperedIndex) {
+    for (uint16_t bit = 0; bit < XMSS_H; bit++) {
+        const auto s = make(0, 100, TAMPER_INDEX, bit);
+        EXPECT_FALSE(xmss_verify(&s.pk, s.msg, &s.sig)) << "bit " << bit;
+    }
+
+    // out of the tree
+    auto s = make(0, 100, TAMPER_NONE, 0);
+    s.sig.index = NtoHL(XMSS_NUM_NODES);
+    EXPECT_FALSE(xmss_verify(&s.pk, s.msg, &s.sig));
+}
+
+TEST_F(XmssVerify, TamperedMessageRandomnessAndKey) {
+    auto s = make(0, 9, TAMPER_MSG, 3);
+    EXPECT_FALSE(xmss_verify(&s.pk, s.msg, &s.sig));
+
+    s = make(0, 9, TAMPER_RANDOMNESS, 0);
+    EXPECT_FALSE(xmss_verify(&s.pk, s.msg, &s.sig));
+
+    s = make(0, 9, TAMPER_NONE, 0);
+    const xmss_pk_t other = keys[1]->pk();
+    EXPECT_FALSE(xmss_verify(&other, s.msg, &s.sig));
+}
+
+TEST_F(XmssVerify, BatchMatchesSingle) {
+    // more than one group per key, keys interleaved, and forgeries next to valid signatures
+    // that share their auth path nodes: siblings, the same index and the same subtree
+    std::vector<signed_msg_t> batch;
+    for (uint16_t i = 0; i < 2 * XMSS_VERIFY_GROUP + 5; i++) {
+        const uint8_t k = (uint8_t) (i % 3 == 0);
+        const uint16_t index = (uint16_t) ((i * 37u) & 0xFFu);
+        const tamper_t tamper = (tamper_t) (i % 7 < 5 ? TAMPER_NONE : i % 5 + 1);
+        batch.push_back(make(k, index, tamper, i));
+
+        if (i % 9 == 0) {
+            batch.push_back(make(k, index ^ 1u, TAMPER_AUTHPATH, i));
+            batch.push_back(make(k, index, TAMPER_WOTS, i));
+            batch.push_back(make(k, index ^ 2u, TAMPER_AUTHPATH, WOTS_N + 7));
+        }
+    }
+
+    const uint16_t n = (uint16_t) batch.size();
+    std::vector<const xmss_pk_t *> pk(n);
+    std::vector<const uint8_t *> msg(n);
+    std::vector<const xmss_signature_t *> sig(n);
+    std::unique_ptr<bool[]> results(new bool[n]);
+    uint16_t expected_valid = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        pk[i] = &batch[i].pk;
+        msg[i] = batch[i].msg;
+        sig[i] = &batch[i].sig;
+        ASSERT_EQ(xmss_verify(pk[i], msg[i], sig[i]), batch[i].valid) << "entry " << i;
+        expected_valid += batch[i].valid;
+    }
+
+    EXPECT_EQ(xmss_verify_batch(results.get(), pk.data(), msg.data(), sig.data(), n), expected_valid);
+    for (uint16_t i = 0; i < n; i++) {
+        EXPECT_EQ(results[i], batch[i].valid) << "entry " << i;
+    }
+}
+
+TEST_F(XmssVerify, BatchForgeryBeforeValid) {
+    // the forged sibling is checked before the valid signature that authenticates its nodes
+    const auto forged = make(1, 10, TAMPER_AUTHPATH, 0);
+    const auto valid = make(1, 11, TAMPER_NONE, 0);
+
+    const xmss_pk_t *pk[2] = {&forged.pk, &valid.pk};
+    const uint8_t *msg[2] = {forged.msg, valid.msg};
+    const xmss_signature_t *sig[2] = {&forged.sig, &valid.sig};
+    bool results[2];
+    EXPECT_EQ(xmss_verify_batch(results, pk, msg, sig, 2), 1);
+    EXPECT_FALSE(results[0]);
+    EXPECT_TRUE(results[1]);
+}
+
+}